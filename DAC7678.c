@@ -6,6 +6,9 @@
  */
 
 #include "DAC7678.h"
+#ifdef DAC7678_TRACE
+#include "DAC7678_trace.h"
+#endif
 
 #ifdef DAC7678_TEST
 #include <stdio.h>
@@ -13,554 +16,1857 @@
 #include <math.h>
 #endif
 
-static uint8_t s_init = 0;
+#define DAC7678_QUEUE_MASK (DAC7678_QUEUE_SIZE - 1)
+
+// the queue indexes wrap by mask and live in uint8_t
+_Static_assert((DAC7678_QUEUE_SIZE & (DAC7678_QUEUE_SIZE - 1)) == 0, "DAC7678_QUEUE_SIZE must be a power of two");
+_Static_assert(DAC7678_QUEUE_SIZE <= 256, "DAC7678_QUEUE_SIZE must fit the uint8_t queue indexes");
+
+#define DAC7678_STALL_TIMEOUT_MS ((DAC7678_STALL_TIMEOUT_US + 999) / 1000) // HAL blocking calls take ms
+
+static DAC7678_Bus s_buses[DAC7678_MAX_BUSES];
+static DAC7678_TimeSource s_time_source = NULL;
+
+void DAC7678_set_time_source(DAC7678_TimeSource now_us)
+{
+	s_time_source = now_us;
+}
+
+uint32_t DAC7678_now_us(void)
+{
+	// tick * 1000 wraps at 2^32 like a microsecond counter, so deadlines stay wrap-safe
+	return s_time_source ? s_time_source() : HAL_GetTick() * 1000UL;
+}
+
+static uint8_t DAC7678_expired(const uint32_t deadline)
+{
+	return (int32_t)(DAC7678_now_us() - deadline) >= 0;
+}
+
+#ifdef DAC7678_PERF
+#define DAC7678_PERF_BEGIN()					const uint32_t perf_start = DAC7678_now_us()
+#define DAC7678_PERF_END(device, call)			DAC7678_perf_latency(device, call, perf_start)
+#define DAC7678_PERF_TRANSFER(device, tx, rx)	DAC7678_perf_transfer(device, tx, rx)
+#define DAC7678_PERF_COUNT(device, counter, n)	do { if (device) (device)->m_perf.counter += (n); } while (0)
+#define DAC7678_PERF_STATE(device, state)		DAC7678_perf_state(device, state)
+
+static void DAC7678_perf_transfer(DAC7678 *device, const uint16_t tx, const uint16_t rx)
+{
+	if (device == NULL) return;
+
+	// a write-read sends the address again after its repeated START
+	device->m_perf.transactions++;
+	device->m_perf.bytes += 1U + tx + (rx ? 1U + rx : 0U);
+}
+
+static void DAC7678_perf_state(DAC7678 *device, const DAC7678_State state)
+{
+	if ((device != NULL) && ((state == DAC7678_ERROR_TIMEOUT_TX) || (state == DAC7678_ERROR_TIMEOUT_RX))) device->m_perf.timeouts++;
+}
+
+static void DAC7678_perf_latency(DAC7678 *device, const DAC7678_PerfCall call, const uint32_t start)
+{
+	if (!device->m_init) return;
+
+	const uint32_t us = DAC7678_now_us() - start;
+	uint8_t bucket = us ? (uint8_t)(32 - __builtin_clz(us)) : 0;
+	if (bucket >= DAC7678_PERF_BUCKETS) bucket = DAC7678_PERF_BUCKETS - 1;
+	device->m_perf.latency[call][bucket]++;
+}
+#else
+#define DAC7678_PERF_BEGIN()
+#define DAC7678_PERF_END(device, call)			((void)0)
+#define DAC7678_PERF_TRANSFER(device, tx, rx)	((void)0)
+#define DAC7678_PERF_COUNT(device, counter, n)	((void)0)
+#define DAC7678_PERF_STATE(device, state)		((void)0)
+#endif
+
+#ifdef DAC7678_TRACE
+#define DAC7678_TRACE_START(bus, address, data, size, rx_size)		DAC7678_trace_start(bus, address, data, size, rx_size)
+#define DAC7678_TRACE_DONE(bus, address, command, state, rx, rx_size)	DAC7678_trace_record((uint8_t)((bus) - s_buses), DAC7678_TRACE_DONE, address, state, command, rx, rx_size)
+#define DAC7678_TRACE_WIRE_DONE(bus, state)							DAC7678_trace_wire_done(bus, state)
+
+static void DAC7678_trace_start(const DAC7678_Bus *bus, const uint8_t address, const uint8_t *data, const uint16_t size, const uint8_t rx_size)
+{
+	const uint8_t index = (uint8_t)(bus - s_buses);
+	if (rx_size) DAC7678_trace_record(index, DAC7678_TRACE_READ, address, DAC7678_NONE, data[0], NULL, rx_size);
+	else DAC7678_trace_record(index, DAC7678_TRACE_WRITE, address, DAC7678_NONE, data[0], data + 1, (uint8_t)(size - 1));
+}
+
+// the transfer an async bus has on the wire: the head of the active queue, or the direct frame
+static void DAC7678_trace_wire_done(const DAC7678_Bus *bus, const DAC7678_State state)
+{
+	const DAC7678 *device = bus->m_active;
+	if (device)
+	{
+		const DAC7678_Transfer *transfer = &device->m_queue[device->m_queue_head];
+		const uint8_t rx_size = (state == DAC7678_OK) ? transfer->rx_size : 0;
+		DAC7678_TRACE_DONE(bus, device->m_address, transfer->data[0], state, transfer->rx, rx_size);
+	}
+	else if (bus->m_direct.size)
+	{
+		DAC7678_TRACE_DONE(bus, bus->m_direct.address, bus->m_direct.data[0], state, NULL, 0);
+	}
+}
+#else
+#define DAC7678_TRACE_START(bus, address, data, size, rx_size)		((void)0)
+#define DAC7678_TRACE_DONE(bus, address, command, state, rx, rx_size)	((void)0)
+#define DAC7678_TRACE_WIRE_DONE(bus, state)							((void)0)
+#endif
+
+static uint8_t DAC7678_hal_is_ready(I2C_HandleTypeDef *hi2c)
+{
+	return hi2c->State == HAL_I2C_STATE_READY;
+}
+
+// HAL status and error code of a failed transfer, most specific cause first
+static DAC7678_State DAC7678_hal_error(I2C_HandleTypeDef *hi2c, const HAL_StatusTypeDef status, const uint8_t rx)
+{
+	if (status == HAL_OK) return DAC7678_OK;
+
+	const uint32_t error = HAL_I2C_GetError(hi2c);
+	if (error & HAL_I2C_ERROR_BERR) return DAC7678_ERROR_BUS;
+	if (error & HAL_I2C_ERROR_ARLO) return DAC7678_ERROR_ARBITRATION;
+	if (error & HAL_I2C_ERROR_AF) return DAC7678_ERROR_NACK;
+	if ((status == HAL_TIMEOUT) || (error & HAL_I2C_ERROR_TIMEOUT)) return rx ? DAC7678_ERROR_TIMEOUT_RX : DAC7678_ERROR_TIMEOUT_TX;
+
+	return rx ? DAC7678_ERROR_RX : DAC7678_ERROR_TX;
+}
+
+// NOTE: HAL timeouts are per flag; the caller's deadline is left to spend, at most one stall period
+static uint32_t DAC7678_hal_timeout(I2C_HandleTypeDef *hi2c)
+{
+	DAC7678_Bus *bus = DAC7678_get_bus(hi2c);
+
+	return bus ? bus->m_hal_timeout_ms : DAC7678_STALL_TIMEOUT_MS;
+}
+
+static DAC7678_State DAC7678_blocking_transmit(I2C_HandleTypeDef *hi2c, const uint8_t address, uint8_t *data, const uint16_t size)
+{
+	return DAC7678_hal_error(hi2c, HAL_I2C_Master_Transmit(hi2c, address << 1, data, size, DAC7678_hal_timeout(hi2c)), 0);
+}
+
+// command byte, repeated START, readback: one transaction, no other master can slip in
+static DAC7678_State DAC7678_blocking_write_read(I2C_HandleTypeDef *hi2c, const uint8_t address, const uint8_t command, uint8_t *data, const uint16_t size)
+{
+	return DAC7678_hal_error(hi2c, HAL_I2C_Mem_Read(hi2c, address << 1, command, I2C_MEMADD_SIZE_8BIT, data, size, DAC7678_hal_timeout(hi2c)), 1);
+}
+
+static DAC7678_State DAC7678_it_transmit(I2C_HandleTypeDef *hi2c, const uint8_t address, uint8_t *data, const uint16_t size)
+{
+	return DAC7678_hal_error(hi2c, HAL_I2C_Master_Transmit_IT(hi2c, address << 1, data, size), 0);
+}
+
+static DAC7678_State DAC7678_it_write_read(I2C_HandleTypeDef *hi2c, const uint8_t address, const uint8_t command, uint8_t *data, const uint16_t size)
+{
+	return DAC7678_hal_error(hi2c, HAL_I2C_Mem_Read_IT(hi2c, address << 1, command, I2C_MEMADD_SIZE_8BIT, data, size), 1);
+}
+
+static DAC7678_State DAC7678_dma_transmit(I2C_HandleTypeDef *hi2c, const uint8_t address, uint8_t *data, const uint16_t size)
+{
+	return DAC7678_hal_error(hi2c, HAL_I2C_Master_Transmit_DMA(hi2c, address << 1, data, size), 0);
+}
+
+static DAC7678_State DAC7678_dma_write_read(I2C_HandleTypeDef *hi2c, const uint8_t address, const uint8_t command, uint8_t *data, const uint16_t size)
+{
+	return DAC7678_hal_error(hi2c, HAL_I2C_Mem_Read_DMA(hi2c, address << 1, command, I2C_MEMADD_SIZE_8BIT, data, size), 1);
+}
+
+const DAC7678_Transport DAC7678_TRANSPORT_BLOCKING =
+{
+	DAC7678_blocking_transmit, DAC7678_blocking_write_read, DAC7678_hal_is_ready, 0
+};
+
+const DAC7678_Transport DAC7678_TRANSPORT_IT =
+{
+	DAC7678_it_transmit, DAC7678_it_write_read, DAC7678_hal_is_ready, 1
+};
+
+const DAC7678_Transport DAC7678_TRANSPORT_DMA =
+{
+	DAC7678_dma_transmit, DAC7678_dma_write_read, DAC7678_hal_is_ready, 1
+};
+
+// 0, 1, 2, 4 .. DAC7678_BACKOFF_US before restart n; the first one is immediate, a glitch costs only the repeated frame
+static uint32_t DAC7678_backoff(const uint8_t attempt)
+{
+	return ((1UL << attempt) >> 1) * DAC7678_BACKOFF_US;
+}
+
+// bus errors and timeouts leave the peripheral, or a slave holding SDA, in an unknown state
+static uint8_t DAC7678_needs_recovery(const DAC7678_State state)
+{
+	return (state == DAC7678_ERROR_BUS) || (state == DAC7678_ERROR_TIMEOUT_TX) || (state == DAC7678_ERROR_TIMEOUT_RX);
+}
+
+// whatever is on the wire is lost; the pins are GPIO between DeInit and Init, so the bus clear goes there
+static void DAC7678_recover(DAC7678_Bus *bus)
+{
+	bus->recoveries++;
+	bus->m_aborting = 0;
+	HAL_I2C_DeInit(bus->m_hi2c);
+	if (bus->m_bus_clear) bus->m_bus_clear(bus->m_hi2c);
+	HAL_I2C_Init(bus->m_hi2c);
+	bus->m_recover = 0;
+}
+
+// a transfer goes on the wire: the stall watch counts from here, not from the last poll that saw the bus idle
+static void DAC7678_watch(DAC7678_Bus *bus)
+{
+	bus->m_watch_progress = bus->m_progress;
+	bus->m_watch_since = DAC7678_now_us();
+}
+
+// NOTE: device NULL for bus-wide transfers, which take DAC7678_TIMEOUT_US
+static uint32_t DAC7678_deadline(const DAC7678 *device)
+{
+	return DAC7678_now_us() + (device ? device->m_timeout_us : DAC7678_TIMEOUT_US);
+}
+
+// what is left of the deadline for one blocking HAL call, in whole ms
+static void DAC7678_sync_budget(DAC7678_Bus *bus, const uint32_t deadline)
+{
+	const int32_t left = (int32_t)(deadline - DAC7678_now_us());
+	const uint32_t ms = (left > 0) ? ((uint32_t)left + 999) / 1000 : 1;
+
+	bus->m_hal_timeout_ms = (ms < DAC7678_STALL_TIMEOUT_MS) ? ms : DAC7678_STALL_TIMEOUT_MS;
+}
+
+// blocking transports retry in place, with the recovery and backoff the error interrupt uses, until the deadline
+static uint8_t DAC7678_sync_retry(DAC7678_Bus *bus, const DAC7678_State state, const uint8_t attempt, const uint32_t deadline)
+{
+	if (!DAC7678_bus_error(state)) return 0;
+
+	const uint32_t retry_at = DAC7678_now_us() + DAC7678_backoff(attempt);
+	if ((attempt >= bus->m_retries) || ((int32_t)(retry_at - deadline) > 0))
+	{
+		// out of retries or time: the next call re-inits, this one returns now
+		if (DAC7678_needs_recovery(state)) bus->m_recover = 1;
+		return 0;
+	}
+
+	if (DAC7678_needs_recovery(state)) DAC7678_recover(bus);
+	bus->retries++;
+
+	while (!DAC7678_expired(retry_at)) {}
+
+	return 1;
+}
+
+static DAC7678_State DAC7678_wait_ready(DAC7678_Bus *bus, DAC7678 *device, const DAC7678_Transport *transport, const uint32_t deadline, const DAC7678_State timeout_state)
+{
+	if (transport->is_ready(bus->m_hi2c) && !bus->m_holdoff && !bus->m_recover) return DAC7678_OK;
+
+	// a transfer waiting out its backoff still owns the bus
+#ifdef DAC7678_PERF
+	const uint32_t start = DAC7678_now_us();
+#else
+	(void)device;
+#endif
+	DAC7678_State state = DAC7678_OK;
+	while (!transport->is_ready(bus->m_hi2c) || bus->m_holdoff || bus->m_recover)
+	{
+		DAC7678_bus_service(bus);
+		if (DAC7678_expired(deadline))
+		{
+			state = timeout_state;
+			break;
+		}
+	}
+	DAC7678_PERF_COUNT(device, spin_us, DAC7678_now_us() - start);
+	DAC7678_PERF_STATE(device, state);
+
+	return state;
+}
+
+static DAC7678_State DAC7678_transmit_to(DAC7678_Bus *bus, DAC7678 *device, const DAC7678_Transport *transport, const uint8_t address, uint8_t *data, const uint16_t size)
+{
+	const uint32_t deadline = DAC7678_deadline(device);
+	DAC7678_State state = DAC7678_wait_ready(bus, device, transport, deadline, DAC7678_ERROR_TIMEOUT_TX);
+	if (state != DAC7678_OK) return state;
+
+	if (transport->async)
+	{
+		// kept for the error interrupt, which restarts the frame or reports it through the device
+		bus->m_direct = (DAC7678_Direct){ device, transport, data, size, address };
+		DAC7678_watch(bus);
+		DAC7678_PERF_TRANSFER(device, size, 0);
+		DAC7678_TRACE_START(bus, address, data, size, 0);
+		state = transport->transmit(bus->m_hi2c, address, data, size);
+		if (state != DAC7678_OK)
+		{
+			DAC7678_TRACE_DONE(bus, address, data[0], state, NULL, 0);
+			bus->m_direct.size = 0;
+		}
+
+		return state;
+	}
+
+	for (uint8_t attempt = 0; ; ++attempt)
+	{
+		DAC7678_PERF_TRANSFER(device, size, 0);
+		DAC7678_TRACE_START(bus, address, data, size, 0);
+		DAC7678_sync_budget(bus, deadline);
+		state = transport->transmit(bus->m_hi2c, address, data, size);
+		DAC7678_TRACE_DONE(bus, address, data[0], state, NULL, 0);
+		if (state == DAC7678_OK) return state;
+
+		DAC7678_PERF_STATE(device, state);
+		if (!DAC7678_sync_retry(bus, state, attempt, deadline)) return state;
+		DAC7678_PERF_COUNT(device, retries, 1);
+	}
+}
+
+static void DAC7678_kick(DAC7678_Bus *bus);
+
+// a blocking transfer has no completion interrupt to restart queued work of async neighbours
+static void DAC7678_sync_done(DAC7678_Bus *bus)
+{
+	if (!bus->m_mixed) return;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	DAC7678_kick(bus);
+	__set_PRIMASK(primask);
+}
+
+static DAC7678_State DAC7678_transmit(DAC7678 *device, uint8_t *data, const uint16_t size)
+{
+	DAC7678_State state = DAC7678_transmit_to(device->m_bus, device, device->m_transport, device->m_address, data, size);
+	if (!device->m_transport->async) DAC7678_sync_done(device->m_bus);
+
+	return state;
+}
+
+static DAC7678_State DAC7678_write_read(DAC7678 *device, const uint8_t command, uint8_t *data, const uint16_t size)
+{
+	const uint32_t deadline = DAC7678_deadline(device);
+	DAC7678_State state = DAC7678_wait_ready(device->m_bus, device, device->m_transport, deadline, DAC7678_ERROR_TIMEOUT_RX);
+	if (state != DAC7678_OK) return state;
+
+	for (uint8_t attempt = 0; ; ++attempt)
+	{
+		DAC7678_PERF_TRANSFER(device, 1, size);
+		DAC7678_TRACE_START(device->m_bus, device->m_address, &command, 1, (uint8_t)size);
+		DAC7678_sync_budget(device->m_bus, deadline);
+		state = device->m_transport->write_read(device->m_hi2c, device->m_address, command, data, size);
+		DAC7678_TRACE_DONE(device->m_bus, device->m_address, command, state, data, (state == DAC7678_OK) ? (uint8_t)size : 0);
+		if (state == DAC7678_OK) break;
+
+		DAC7678_PERF_STATE(device, state);
+		if (!DAC7678_sync_retry(device->m_bus, state, attempt, deadline)) break;
+		DAC7678_PERF_COUNT(device, retries, 1);
+	}
+	DAC7678_sync_done(device->m_bus);
+
+	return state;
+}
+
+// NOTE: a frame is refilled only after the transfer that followed it has started, so never while on the wire
+static uint8_t *DAC7678_next_frame(DAC7678 *device)
+{
+	device->m_frame_idx = (device->m_frame_idx + 1) % DAC7678_TX_FRAMES;
+
+	return device->m_frame[device->m_frame_idx];
+}
+
+// config registers 0x40..0x90 map to mirror slots 0..5, held in readback format
+static void DAC7678_mirror(DAC7678 *device, const uint8_t *frame)
+{
+	const uint8_t reg = (uint8_t)((frame[0] >> 4) - 4);
+	uint8_t *mirror = device->m_mirror[reg];
+
+	switch (frame[0])
+	{
+	case DAC7678_CMD_WRITE_PWR:
+		mirror[0] = (frame[1] >> 5) & 0x03;
+		mirror[1] = (uint8_t)(((frame[1] & 0x1F) << 3) | (frame[2] >> 5));
+		break;
+	case DAC7678_CMD_WRITE_CLR_CODE:
+		mirror[0] = 0x00;
+		mirror[1] = (frame[2] >> 4) & 0x03;
+		break;
+	case DAC7678_CMD_WRITE_LDAC:
+		mirror[0] = 0x00;
+		mirror[1] = frame[1];
+		break;
+	case DAC7678_CMD_WRITE_REF_STATIC:
+		mirror[0] = 0x00;
+		mirror[1] = (frame[2] >> 4) & 0x01;
+		break;
+	case DAC7678_CMD_WRITE_REF_FLEX:
+		mirror[0] = 0x00;
+		mirror[1] = (frame[1] >> 4) & 0x07;
+		break;
+	default:
+		return;
+	}
+
+	device->m_mirror_tick[reg] = HAL_GetTick();
+	device->m_mirror_valid |= (uint8_t)(1 << reg);
+}
+
+// the bus object of an I2C handle, claimed on first use
+static DAC7678_Bus *DAC7678_bus_claim(I2C_HandleTypeDef *hi2c, const DAC7678_Transport *transport)
+{
+	DAC7678_Bus *bus = DAC7678_get_bus(hi2c);
+	if (bus)
+	{
+		if (bus->m_transport != transport) bus->m_mixed = 1;
+		return bus;
+	}
+
+	for (uint8_t i = 0; i < DAC7678_MAX_BUSES; ++i)
+	{
+		if (s_buses[i].m_hi2c == NULL)
+		{
+			s_buses[i].m_hi2c = hi2c;
+			s_buses[i].m_transport = transport;
+			s_buses[i].m_active = NULL;
+			s_buses[i].m_next = 0;
+			s_buses[i].m_mixed = 0;
+			s_buses[i].m_clock = NULL;
+			s_buses[i].m_direct.size = 0;
+			s_buses[i].m_bus_clear = NULL;
+			s_buses[i].m_retries = DAC7678_RETRIES;
+			s_buses[i].m_attempt = 0;
+			s_buses[i].m_holdoff = 0;
+			s_buses[i].m_aborting = 0;
+			s_buses[i].m_recover = 0;
+			s_buses[i].m_hal_timeout_ms = DAC7678_STALL_TIMEOUT_MS;
+			s_buses[i].m_progress = 0;
+			s_buses[i].m_watch_progress = 0;
+			s_buses[i].m_watch_since = DAC7678_now_us();
+			s_buses[i].retries = 0;
+			s_buses[i].recoveries = 0;
+			return &s_buses[i];
+		}
+	}
+
+	return NULL;
+}
+
+DAC7678_Bus *DAC7678_get_bus(I2C_HandleTypeDef *hi2c)
+{
+	for (uint8_t i = 0; i < DAC7678_MAX_BUSES; ++i)
+	{
+		if (s_buses[i].m_hi2c == hi2c) return &s_buses[i];
+	}
+
+	return NULL;
+}
 
 DAC7678_State DAC7678_init(DAC7678 *device, I2C_HandleTypeDef *hi2c, const uint8_t address)
 {
+	return DAC7678_init_transport(device, hi2c, address, DAC7678_TRANSPORT_DEFAULT);
+}
+
+DAC7678_State DAC7678_init_transport(DAC7678 *device, I2C_HandleTypeDef *hi2c, const uint8_t address, const DAC7678_Transport *transport)
+{
+	if (transport == NULL) return DAC7678_ERROR;
+
+	// re-init moves the device, never registers it twice
+	for (uint8_t i = 0; i < DAC7678_MAX_BUSES; ++i)
+	{
+		for (uint8_t j = 0; j < DAC7678_MAX_DEVICES; ++j)
+		{
+			if (s_buses[i].m_devices[j] == device) s_buses[i].m_devices[j] = NULL;
+		}
+	}
+
+	DAC7678_Bus *bus = DAC7678_bus_claim(hi2c, transport);
+	if (bus == NULL) return DAC7678_ERROR;
+
+	uint8_t slot = DAC7678_MAX_DEVICES;
+	for (uint8_t i = 0; i < DAC7678_MAX_DEVICES; ++i)
+	{
+		if ((bus->m_devices[i] == NULL) && (slot == DAC7678_MAX_DEVICES)) slot = i;
+	}
+	if (slot == DAC7678_MAX_DEVICES) return DAC7678_ERROR;
+
 	device->m_hi2c = hi2c;
+	device->m_bus = bus;
+	device->m_transport = transport;
 	device->m_address = address;
 	device->m_write_options = DAC7678_WRT_NONE;
-	s_init = 1;
+	device->m_queue_head = 0;
+	device->m_queue_tail = 0;
+	device->m_frame_idx = 0;
+	device->m_shadow_valid = DAC7678_CHM_NONE;
+	device->m_cal_enabled = DAC7678_CHM_NONE;
+	device->m_error = DAC7678_OK;
+	device->m_full_scale = DAC7678_VREF_INTERNAL_MV;
+	device->m_unit_scale = DAC7678_UNIT_SCALE(DAC7678_VREF_INTERNAL_MV);
+	device->m_mirror_valid = 0;
+	device->m_cache_policy = DAC7678_CACHE_OFF;
+	device->m_cache_period = 0;
+	device->m_timeout_us = DAC7678_TIMEOUT_US;
+#ifdef DAC7678_PERF
+	device->m_perf = (DAC7678_Perf){ 0 };
+#endif
+	device->writes_sent = 0;
+	device->writes_elided = 0;
+	device->cache_hits = 0;
+	device->cache_mismatches = 0;
+	device->m_init = 1;
+
+	bus->m_devices[slot] = device;
 
 	return DAC7678_OK;
 }
 
 DAC7678_State DAC7678_deinit(DAC7678 *device)
 {
+	if (!device->m_init) return DAC7678_ERROR;
+
+	DAC7678_Bus *bus = device->m_bus;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+
+	// a retry or a completion would reach the device through the bus, and queued callbacks would never run
+	if ((device->m_queue_head != device->m_queue_tail) || (bus->m_active == device) ||
+			(bus->m_direct.size && (bus->m_direct.device == device)))
+	{
+		__set_PRIMASK(primask);
+		return DAC7678_ERROR;
+	}
+
+	uint8_t used = 0;
+	for (uint8_t i = 0; i < DAC7678_MAX_DEVICES; ++i)
+	{
+		if (bus->m_devices[i] == device) bus->m_devices[i] = NULL;
+		if (bus->m_devices[i]) used = 1;
+	}
+	if (!used && bus->m_active == NULL) bus->m_hi2c = NULL;
+	__set_PRIMASK(primask);
+
 	device->m_hi2c = NULL;
+	device->m_bus = NULL;
 	device->m_address = 0x00;
 	device->m_write_options = DAC7678_WRT_NONE;
-	s_init = 0;
+	device->m_init = 0;
 
 	return DAC7678_OK;
 }
 
 DAC7678_State DAC7678_set_write_options(DAC7678 *device, const DAC7678_WriteOptions options)
 {
-	if (!s_init) return DAC7678_ERROR;
+	if (!device->m_init) return DAC7678_ERROR;
 
 	device->m_write_options = options;
 
 	return DAC7678_OK;
 }
 
-DAC7678_State DAC7678_set_value(DAC7678 *device, const DAC7678_ChannelIdx channel, const uint16_t value)
+DAC7678_State DAC7678_set_calibration(DAC7678 *device, const DAC7678_ChannelIdx channel, const int32_t gain, const int32_t offset)
 {
-	if (!s_init) return DAC7678_ERROR;
-	if (value > DAC7678_MAX_VALUE) return DAC7678_ERROR_INVALID_VALUE;
-	if ((channel > DAC7678_MAX_CHANNELS) && (channel != 0x0F)) return DAC7678_ERROR_INVALID_CHANNEL;
+	if (!device->m_init) return DAC7678_ERROR;
+	if (channel >= DAC7678_MAX_CHANNELS) return DAC7678_ERROR_INVALID_CHANNEL;
+	// 32-bit products only, Cortex-M0 has no long multiply
+	if ((gain < 0) || (gain > 0x20000) || (offset < -0x10000000L) || (offset > 0x10000000L)) return DAC7678_ERROR_INVALID_VALUE;
+
+	device->m_cal[channel].gain = gain;
+	device->m_cal[channel].offset = offset;
+	if (!(device->m_cal_enabled & (1 << channel))) device->m_cal[channel].inl = NULL;
+	device->m_cal_enabled |= (uint8_t)(1 << channel);
+	// the shadow holds ideal codes, the chip now holds something else
+	device->m_shadow_valid &= (uint8_t)~(1 << channel);
 
-	device->m_data_tx[0] = (uint8_t)(device->m_write_options | channel);
-	device->m_data_tx[1] = (uint8_t)(value >> 4);
-	device->m_data_tx[2] = (uint8_t)(value << 4);
+	return DAC7678_OK;
+}
+
+DAC7678_State DAC7678_set_inl(DAC7678 *device, const DAC7678_ChannelIdx channel, const int16_t *table, const uint8_t inl_bits)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+	if (channel >= DAC7678_MAX_CHANNELS) return DAC7678_ERROR_INVALID_CHANNEL;
+	if ((table != NULL) && ((inl_bits == 0) || (inl_bits > DAC7678_CAL_INL_MAX_BITS))) return DAC7678_ERROR_INVALID_VALUE;
 
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeout = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
+	if (!(device->m_cal_enabled & (1 << channel)))
 	{
-		if (HAL_GetTick() > timeout) return DAC7678_ERROR_TIMEOUT_TX;
+		device->m_cal[channel].gain = 0x10000;
+		device->m_cal[channel].offset = 0;
 	}
-	if (HAL_I2C_Master_Transmit_IT(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Transmit(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3, DAC7678_TIMEOUT) != HAL_OK)
-#endif
+	device->m_cal[channel].inl = table;
+	device->m_cal[channel].inl_bits = inl_bits;
+	device->m_cal_enabled |= (uint8_t)(1 << channel);
+	device->m_shadow_valid &= (uint8_t)~(1 << channel);
+
+	return DAC7678_OK;
+}
+
+DAC7678_State DAC7678_clear_calibration(DAC7678 *device, const DAC7678_ChannelMsk channel_mask)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+	device->m_cal_enabled &= (uint8_t)~channel_mask;
+	device->m_shadow_valid &= (uint8_t)~channel_mask;
+
+	return DAC7678_OK;
+}
+
+uint16_t DAC7678_calibrate(const DAC7678 *device, const DAC7678_ChannelIdx channel, const uint16_t value)
+{
+	if ((channel >= DAC7678_MAX_CHANNELS) || !(device->m_cal_enabled & (1 << channel))) return value;
+
+	const DAC7678_Calibration *cal = &device->m_cal[channel];
+	int32_t code = (int32_t)value * cal->gain + cal->offset; // Q16
+	if (cal->inl)
+	{
+		int32_t at = (code + 0x8000) >> 16;
+		if (at < 0) at = 0;
+		if (at > DAC7678_MAX_VALUE) at = DAC7678_MAX_VALUE;
+
+		// error in 1/16 LSB, linear between the two neighbouring points
+		const uint8_t shift = (uint8_t)(12 - cal->inl_bits);
+		const int32_t index = at >> shift;
+		const int32_t error = cal->inl[index] + (((cal->inl[index + 1] - cal->inl[index]) * (at & ((1 << shift) - 1))) >> shift);
+		code -= error * 4096;
+	}
+
+	if (code < 0) return 0;
+	code = (code + 0x8000) >> 16;
+
+	return (code > DAC7678_MAX_VALUE) ? DAC7678_MAX_VALUE : (uint16_t)code;
+}
+
+DAC7678_State DAC7678_set_full_scale(DAC7678 *device, const uint16_t full_scale)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+	if (full_scale == 0) return DAC7678_ERROR_INVALID_VALUE;
+
+	// the one division, done here so writes only multiply and shift
+	device->m_full_scale = full_scale;
+	device->m_unit_scale = DAC7678_UNIT_SCALE(full_scale);
+
+	return DAC7678_OK;
+}
+
+DAC7678_State DAC7678_set_units(DAC7678 *device, const DAC7678_ChannelIdx channel, const uint16_t units)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+	if (units >= device->m_full_scale) return DAC7678_ERROR_INVALID_VALUE;
+
+	return DAC7678_set_value(device, channel, DAC7678_units_to_code(units, device->m_unit_scale));
+}
+
+// remember what the input register(s) of a channel write hold
+static void DAC7678_shadow(DAC7678 *device, const uint8_t channel, const uint16_t value)
+{
+	if (channel == DAC7678_CH_ALL)
+	{
+		for (uint8_t i = 0; i < DAC7678_MAX_CHANNELS; ++i)
+		{
+			device->m_shadow[i] = value;
+		}
+		device->m_shadow_valid = DAC7678_CHM_ALL;
+		return;
+	}
+
+	device->m_shadow[channel] = value;
+	device->m_shadow_valid |= (uint8_t)(1 << channel);
+}
+
+static DAC7678_State DAC7678_write_channel(DAC7678 *device, const uint8_t command, const uint16_t value)
+{
+	const uint8_t channel = command & 0x0F;
+	if ((channel == DAC7678_CH_ALL) && device->m_cal_enabled)
 	{
-		return DAC7678_ERROR_TX;
+		// corrected codes differ per channel, so no broadcast; load all, latch with the last
+		const uint8_t latch = ((command & 0xF0) == DAC7678_WRT_UPDATE_OFF) ? DAC7678_WRT_UPDATE_OFF : DAC7678_WRT_UPDATE_ALL;
+		for (uint8_t i = 0; i < DAC7678_MAX_CHANNELS; ++i)
+		{
+			DAC7678_State state = DAC7678_write_channel(device, (uint8_t)((i == DAC7678_MAX_CHANNELS - 1 ? latch : DAC7678_WRT_UPDATE_OFF) | i), value);
+			if (state != DAC7678_OK) return state;
+		}
+		return DAC7678_OK;
 	}
 
-	return DAC7678_OK;
+	const uint16_t code = DAC7678_calibrate(device, (DAC7678_ChannelIdx)channel, value);
+	uint8_t *frame = DAC7678_next_frame(device);
+	frame[0] = command;
+	frame[1] = (uint8_t)(code >> 4);
+	frame[2] = (uint8_t)(code << 4);
+
+	DAC7678_State state = DAC7678_transmit(device, frame, 3);
+	if (state != DAC7678_OK) return state;
+
+	DAC7678_shadow(device, command & 0x0F, value);
+	device->writes_sent++;
+
+	return DAC7678_OK;
+}
+
+static DAC7678_State DAC7678_write_value(DAC7678 *device, const DAC7678_ChannelIdx channel, const uint16_t value)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+	if (value > DAC7678_MAX_VALUE) return DAC7678_ERROR_INVALID_VALUE;
+	if ((channel >= DAC7678_MAX_CHANNELS) && (channel != DAC7678_CH_ALL)) return DAC7678_ERROR_INVALID_CHANNEL;
+
+	return DAC7678_write_channel(device, (uint8_t)(device->m_write_options | channel), value);
+}
+
+DAC7678_State DAC7678_set_value(DAC7678 *device, const DAC7678_ChannelIdx channel, const uint16_t value)
+{
+	DAC7678_PERF_BEGIN();
+	const DAC7678_State state = DAC7678_write_value(device, channel, value);
+	DAC7678_PERF_END(device, DAC7678_PERF_SET_VALUE);
+
+	return state;
+}
+
+static DAC7678_State DAC7678_write_values(DAC7678 *device)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+
+	uint8_t equal = 1;
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (device->values[channel] > DAC7678_MAX_VALUE) return DAC7678_ERROR_INVALID_VALUE;
+		if (device->values[channel] != device->values[0]) equal = 0;
+	}
+
+	// the part has no channel auto-increment, but one broadcast write covers all eight
+	if (equal) return DAC7678_write_value(device, DAC7678_CH_ALL, device->values[0]);
+
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		DAC7678_State state = DAC7678_write_channel(device, (uint8_t)(device->m_write_options | channel), device->values[channel]);
+		if (state != DAC7678_OK) return state;
+	}
+
+	return DAC7678_OK;
+}
+
+DAC7678_State DAC7678_set_values(DAC7678 *device)
+{
+	DAC7678_PERF_BEGIN();
+	const DAC7678_State state = DAC7678_write_values(device);
+	DAC7678_PERF_END(device, DAC7678_PERF_SET_VALUES);
+
+	return state;
+}
+
+DAC7678_State DAC7678_set_values_dirty(DAC7678 *device, const DAC7678_WriteOptions options)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+
+	uint8_t dirty = DAC7678_CHM_NONE;
+	uint8_t count = 0;
+	uint8_t last = 0;
+	uint8_t equal = 1;
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (device->values[channel] > DAC7678_MAX_VALUE) return DAC7678_ERROR_INVALID_VALUE;
+		if (device->values[channel] != device->values[0]) equal = 0;
+		if ((device->m_shadow_valid & (1 << channel)) && (device->m_shadow[channel] == device->values[channel])) continue;
+
+		dirty |= (uint8_t)(1 << channel);
+		last = channel;
+		count++;
+	}
+
+	device->writes_elided += DAC7678_MAX_CHANNELS - count;
+	DAC7678_PERF_COUNT(device, writes_elided, DAC7678_MAX_CHANNELS - count);
+	if (count == 0) return DAC7678_OK;
+
+	if ((dirty == DAC7678_CHM_ALL) && equal) return DAC7678_write_channel(device, (uint8_t)(options | DAC7678_CH_ALL), device->values[0]);
+
+	// update all rides on the last write, the others only load input registers
+	const uint8_t command = (options == DAC7678_WRT_UPDATE_ALL) ? DAC7678_WRT_UPDATE_OFF : (uint8_t)options;
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (!(dirty & (1 << channel))) continue;
+
+		DAC7678_State state = DAC7678_write_channel(device, (uint8_t)((channel == last ? (uint8_t)options : command) | channel), device->values[channel]);
+		if (state != DAC7678_OK) return state;
+	}
+
+	return DAC7678_OK;
+}
+
+DAC7678_State DAC7678_set_value_burst(DAC7678 *device, const DAC7678_ChannelIdx channel, const uint16_t *values, const uint8_t count)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+	if ((count == 0) || (count > DAC7678_MAX_BURST)) return DAC7678_ERROR_INVALID_VALUE;
+	if ((channel >= DAC7678_MAX_CHANNELS) && (channel != DAC7678_CH_ALL)) return DAC7678_ERROR_INVALID_CHANNEL;
+
+	for (uint8_t i = 0; i < count; ++i)
+	{
+		if (values[i] > DAC7678_MAX_VALUE) return DAC7678_ERROR_INVALID_VALUE;
+	}
+	// one command byte carries every sample, so a broadcast cannot be corrected per channel
+	if ((channel == DAC7678_CH_ALL) && device->m_cal_enabled) return DAC7678_ERROR_INVALID_CHANNEL;
+
+	DAC7678_State state = DAC7678_wait_ready(device->m_bus, device, device->m_transport, DAC7678_deadline(device), DAC7678_ERROR_TIMEOUT_TX);
+	if (state != DAC7678_OK) return state;
+
+	// one command byte, then MSDB/LSDB pairs; each pair is latched on its own ACK
+	device->m_data_burst[0] = (uint8_t)(device->m_write_options | channel);
+	for (uint8_t i = 0; i < count; ++i)
+	{
+		const uint16_t code = DAC7678_calibrate(device, channel, values[i]);
+		device->m_data_burst[1 + 2 * i] = (uint8_t)(code >> 4);
+		device->m_data_burst[2 + 2 * i] = (uint8_t)(code << 4);
+	}
+
+	state = DAC7678_transmit(device, device->m_data_burst, 1 + 2 * count);
+	if (state != DAC7678_OK) return state;
+
+	DAC7678_shadow(device, channel, values[count - 1]);
+	device->writes_sent++;
+
+	return DAC7678_OK;
+}
+
+DAC7678_State DAC7678_update_dac_reg(DAC7678 *device, const DAC7678_ChannelIdx channel)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+	if ((channel >= DAC7678_MAX_CHANNELS) && (channel != DAC7678_CH_ALL)) return DAC7678_ERROR_INVALID_CHANNEL;
+
+	uint8_t *frame = DAC7678_next_frame(device);
+	frame[0] = (uint8_t)(DAC7678_CMD_UPDATE_DAC_REG | channel);
+	frame[1] = 0x00;
+	frame[2] = 0x00;
+
+	return DAC7678_transmit(device, frame, 3);
+}
+
+static void DAC7678_decode_value(const uint8_t *rx, void *value, void *unused)
+{
+	(void)unused;
+	*(uint16_t *)value = (uint16_t)((rx[0] << 4) | (rx[1] >> 4));
+}
+
+static void DAC7678_decode_power(const uint8_t *rx, void *options, void *channel_mask)
+{
+	*(DAC7678_PowerOptions *)options = (DAC7678_PowerOptions)(rx[0] << 5);
+	*(DAC7678_ChannelMsk *)channel_mask = (DAC7678_ChannelMsk)(rx[1]);
+}
+
+static void DAC7678_decode_clear(const uint8_t *rx, void *options, void *unused)
+{
+	(void)unused;
+	*(DAC7678_ClearOptions *)options = (DAC7678_ClearOptions)(rx[1] << 4);
+}
+
+static void DAC7678_decode_ldac(const uint8_t *rx, void *channel_mask, void *unused)
+{
+	(void)unused;
+	*(DAC7678_ChannelMsk *)channel_mask = (DAC7678_ChannelMsk)(rx[1]);
+}
+
+static void DAC7678_decode_ref_static(const uint8_t *rx, void *options, void *unused)
+{
+	(void)unused;
+	*(DAC7678_ReferenceStaticOptions *)options = (DAC7678_ReferenceStaticOptions)(rx[1] << 4);
+}
+
+static void DAC7678_decode_ref_flexi(const uint8_t *rx, void *options, void *unused)
+{
+	(void)unused;
+	*(DAC7678_ReferenceFlexiOptions *)options = (DAC7678_ReferenceFlexiOptions)((rx[1] & 0x07) << 4);
+}
+
+// NOTE: packs a config register write payload into frame[1..2]
+typedef void (*DAC7678_Encoder)(uint8_t *frame, const uint8_t arg0, const uint8_t arg1);
+
+static void DAC7678_encode_power(uint8_t *frame, const uint8_t options, const uint8_t channel_mask)
+{
+	const uint16_t channels = (uint16_t)(channel_mask << 5);
+	frame[1] = (uint8_t)((channels >> 8) | options);
+	frame[2] = (uint8_t)(channels & 0xFF);
+}
+
+static void DAC7678_encode_msdb(uint8_t *frame, const uint8_t arg, const uint8_t unused)
+{
+	(void)unused;
+	frame[1] = arg;
+	frame[2] = 0x00;
+}
+
+static void DAC7678_encode_lsdb(uint8_t *frame, const uint8_t arg, const uint8_t unused)
+{
+	(void)unused;
+	frame[1] = 0x00;
+	frame[2] = arg;
+}
+
+typedef enum
+{
+	DAC7678_REG_POWER		= 0,
+	DAC7678_REG_CLEAR		= 1,
+	DAC7678_REG_LDAC		= 2,
+	DAC7678_REG_RESET		= 3,
+	DAC7678_REG_REF_STATIC	= 4,
+	DAC7678_REG_REF_FLEXI	= 5,
+} DAC7678_Reg;
+
+typedef struct
+{
+	uint8_t			command; // write and read share it
+	DAC7678_Encoder	encode;
+	DAC7678_Decoder	decode; // NULL: write only
+} DAC7678_Register;
+
+// indexed like the mirror, (command >> 4) - 4
+static const DAC7678_Register s_registers[DAC7678_MIRROR_REGS] =
+{
+	{ DAC7678_CMD_WRITE_PWR,		DAC7678_encode_power,	DAC7678_decode_power },
+	{ DAC7678_CMD_WRITE_CLR_CODE,	DAC7678_encode_lsdb,	DAC7678_decode_clear },
+	{ DAC7678_CMD_WRITE_LDAC,		DAC7678_encode_msdb,	DAC7678_decode_ldac },
+	{ DAC7678_CMD_RESET,			DAC7678_encode_msdb,	NULL },
+	{ DAC7678_CMD_WRITE_REF_STATIC,	DAC7678_encode_lsdb,	DAC7678_decode_ref_static },
+	{ DAC7678_CMD_WRITE_REF_FLEX,	DAC7678_encode_msdb,	DAC7678_decode_ref_flexi },
+};
+
+static DAC7678_State DAC7678_write_reg(DAC7678 *device, const DAC7678_Reg reg, const uint8_t arg0, const uint8_t arg1)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+
+	uint8_t *frame = DAC7678_next_frame(device);
+	frame[0] = s_registers[reg].command;
+	s_registers[reg].encode(frame, arg0, arg1);
+
+	DAC7678_State state = DAC7678_transmit(device, frame, 3);
+	if (state == DAC7678_OK) DAC7678_mirror(device, frame);
+
+	return state;
+}
+
+DAC7678_State DAC7678_set_power_reg(DAC7678 *device, const DAC7678_PowerOptions options, const DAC7678_ChannelMsk channel_mask)
+{
+	return DAC7678_write_reg(device, DAC7678_REG_POWER, (uint8_t)options, (uint8_t)channel_mask);
+}
+
+DAC7678_State DAC7678_set_clear_reg(DAC7678 *device, const DAC7678_ClearOptions options)
+{
+	return DAC7678_write_reg(device, DAC7678_REG_CLEAR, (uint8_t)options, 0);
+}
+
+DAC7678_State DAC7678_set_ldac_reg(DAC7678 *device, const DAC7678_ChannelMsk channel_mask)
+{
+	return DAC7678_write_reg(device, DAC7678_REG_LDAC, (uint8_t)channel_mask, 0);
+}
+
+DAC7678_State DAC7678_set_int_ref_static_reg(DAC7678 *device, const DAC7678_ReferenceStaticOptions options)
+{
+	return DAC7678_write_reg(device, DAC7678_REG_REF_STATIC, (uint8_t)options, 0);
+}
+
+DAC7678_State DAC7678_set_int_ref_flexi_reg(DAC7678 *device, const DAC7678_ReferenceFlexiOptions options)
+{
+	return DAC7678_write_reg(device, DAC7678_REG_REF_FLEXI, (uint8_t)options, 0);
+}
+
+DAC7678_State DAC7678_reset(DAC7678 *device, const DAC7678_ResetOptions options)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+
+	// input registers return to zero scale, but only once the write lands
+	device->m_shadow_valid = DAC7678_CHM_NONE;
+	device->m_mirror_valid = 0;
+
+	// a plain reset inside an Hs-mode session would drop the chip off the bus
+	uint8_t hs = (uint8_t)options;
+	if (device->m_bus->m_clock && hs == DAC7678_RST) hs = DAC7678_RST_KEEP_HS_MODE;
+
+	return DAC7678_write_reg(device, DAC7678_REG_RESET, hs, 0);
+}
+
+// register reads send the command byte as the memory address, repeated START, then receive
+static DAC7678_State DAC7678_start(DAC7678 *device)
+{
+	DAC7678_Transfer *transfer = &device->m_queue[device->m_queue_head];
+
+	DAC7678_watch(device->m_bus);
+	DAC7678_PERF_TRANSFER(device, transfer->rx_size ? 1 : transfer->size, transfer->rx_size);
+	DAC7678_TRACE_START(device->m_bus, device->m_address, transfer->data, transfer->size, transfer->rx_size);
+	const DAC7678_State state = transfer->rx_size ?
+			device->m_transport->write_read(device->m_hi2c, device->m_address, transfer->data[0], transfer->rx, transfer->rx_size) :
+			device->m_transport->transmit(device->m_hi2c, device->m_address, transfer->data, transfer->size);
+	if (state != DAC7678_OK) DAC7678_TRACE_DONE(device->m_bus, device->m_address, transfer->data[0], state, NULL, 0);
+
+	return state;
+}
+
+// start the next queued transfer, round robin over the devices on the bus
+// NOTE: interrupt context or interrupts masked
+static void DAC7678_kick(DAC7678_Bus *bus)
+{
+	// a direct setter owns the bus; its completion interrupt kicks again
+	if (bus->m_active || bus->m_holdoff || bus->m_recover) return;
+
+	for (uint8_t n = 0; n < DAC7678_MAX_DEVICES; ++n)
+	{
+		const uint8_t i = (uint8_t)((bus->m_next + n) % DAC7678_MAX_DEVICES);
+		DAC7678 *device = bus->m_devices[i];
+		if (device == NULL) continue;
+
+		while (device->m_queue_head != device->m_queue_tail)
+		{
+			// readiness is the transport's to define, like on the blocking path
+			if (!device->m_transport->is_ready(bus->m_hi2c)) return;
+
+			const DAC7678_State state = DAC7678_start(device);
+			if (state == DAC7678_OK)
+			{
+				bus->m_active = device;
+				bus->m_next = (uint8_t)(i + 1);
+				return;
+			}
+
+			DAC7678_Transfer *failed = &device->m_queue[device->m_queue_head];
+			device->m_shadow_valid = DAC7678_CHM_NONE;
+			device->m_queue_head = (device->m_queue_head + 1) & DAC7678_QUEUE_MASK;
+			if (failed->callback) failed->callback(device, state, failed->context);
+		}
+	}
+}
+
+// retire the head entry of the active device and chain the next transfer, interrupt context
+static void DAC7678_retire(DAC7678_Bus *bus, DAC7678_State state)
+{
+	DAC7678 *device = bus->m_active;
+	DAC7678_Transfer *transfer = &device->m_queue[device->m_queue_head];
+	DAC7678_Callback callback = transfer->callback;
+	void *context = transfer->context;
+
+	if (state == DAC7678_OK && transfer->rx_size && transfer->decode)
+	{
+		transfer->decode(transfer->rx, transfer->result[0], transfer->result[1]);
+	}
+
+	// a lost channel write leaves the input registers unknown
+	if (state != DAC7678_OK) device->m_shadow_valid = DAC7678_CHM_NONE;
+
+	device->m_queue_head = (device->m_queue_head + 1) & DAC7678_QUEUE_MASK;
+	bus->m_active = NULL;
+	DAC7678_kick(bus);
+
+	if (callback) callback(device, state, context);
+}
+
+// completion of a queued transfer, or of a direct one that held queued work back
+static void DAC7678_bus_done(I2C_HandleTypeDef *hi2c, const DAC7678_State state)
+{
+	DAC7678_Bus *bus = DAC7678_get_bus(hi2c);
+	if (bus == NULL) return;
+
+	bus->m_progress++;
+	bus->m_attempt = 0;
+	DAC7678_TRACE_WIRE_DONE(bus, state);
+	if (bus->m_active) DAC7678_retire(bus, state);
+	else
+	{
+		bus->m_direct.size = 0;
+		DAC7678_kick(bus);
+	}
+}
+
+// the transfer on the wire, queued or direct, is given up on
+static void DAC7678_give_up(DAC7678_Bus *bus, const DAC7678_State state)
+{
+	bus->m_attempt = 0;
+	if (bus->m_active)
+	{
+		DAC7678_retire(bus, state);
+		return;
+	}
+
+	if (bus->m_direct.size && bus->m_direct.device)
+	{
+		bus->m_direct.device->m_shadow_valid = DAC7678_CHM_NONE;
+		bus->m_direct.device->m_error = state;
+	}
+	bus->m_direct.size = 0;
+	DAC7678_kick(bus);
+}
+
+static DAC7678_State DAC7678_restart(DAC7678_Bus *bus)
+{
+	if (bus->m_active) return DAC7678_start(bus->m_active);
+	if (bus->m_direct.size == 0) return DAC7678_OK;
+
+	DAC7678_watch(bus);
+	DAC7678_PERF_TRANSFER(bus->m_direct.device, bus->m_direct.size, 0);
+	DAC7678_TRACE_START(bus, bus->m_direct.address, bus->m_direct.data, bus->m_direct.size, 0);
+	const DAC7678_State state = bus->m_direct.transport->transmit(bus->m_hi2c, bus->m_direct.address, bus->m_direct.data, bus->m_direct.size);
+	if (state != DAC7678_OK) DAC7678_TRACE_DONE(bus, bus->m_direct.address, bus->m_direct.data[0], state, NULL, 0);
+
+	return state;
+}
+
+// error interrupt, abort or stall: restart the transfer or report it
+// NOTE: interrupt context or interrupts masked; a re-init is left to DAC7678_bus_service, the bus clear takes too long here
+static void DAC7678_fault(DAC7678_Bus *bus, const DAC7678_State state, const uint8_t recover)
+{
+	bus->m_progress++;
+	DAC7678_TRACE_WIRE_DONE(bus, state);
+	if (recover) bus->m_recover = 1;
+
+#ifdef DAC7678_PERF
+	DAC7678 *device = bus->m_active ? bus->m_active : bus->m_direct.device;
+	DAC7678_PERF_STATE(device, state);
+#endif
+
+	if (bus->m_attempt < bus->m_retries)
+	{
+		const uint32_t backoff = DAC7678_backoff(bus->m_attempt);
+		bus->m_attempt++;
+		bus->retries++;
+		DAC7678_PERF_COUNT(device, retries, 1);
+
+		if (backoff || bus->m_recover)
+		{
+			bus->m_retry_at = DAC7678_now_us() + backoff;
+			bus->m_holdoff = 1;
+			return;
+		}
+
+		const DAC7678_State restarted = DAC7678_restart(bus);
+		if (restarted == DAC7678_OK) return;
+
+		DAC7678_give_up(bus, restarted);
+		return;
+	}
+
+	DAC7678_give_up(bus, state);
+}
+
+// NOTE: one producer per device; entries are filled past the tail, then published
+static DAC7678_Transfer *DAC7678_slot(DAC7678 *device, const uint8_t offset)
+{
+	return &device->m_queue[(device->m_queue_tail + offset) & DAC7678_QUEUE_MASK];
+}
+
+static DAC7678_State DAC7678_reserve(DAC7678 *device, const uint8_t count)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+	if (DAC7678_queue_pending(device) + count > DAC7678_QUEUE_MASK) return DAC7678_ERROR_QUEUE_FULL;
+
+	return DAC7678_OK;
+}
+
+static void DAC7678_fill_write(DAC7678_Transfer *transfer, const uint8_t command, const uint8_t msdb, const uint8_t lsdb)
+{
+	transfer->data[0] = command;
+	transfer->data[1] = msdb;
+	transfer->data[2] = lsdb;
+	transfer->size = 3;
+	transfer->rx_size = 0;
+	transfer->decode = NULL;
+	transfer->callback = NULL;
+	transfer->context = NULL;
+}
+
+static void DAC7678_fill_read(DAC7678_Transfer *transfer, const uint8_t command, DAC7678_Decoder decode, void *result0, void *result1)
+{
+	transfer->data[0] = command;
+	transfer->size = 1;
+	transfer->rx_size = 2;
+	transfer->decode = decode;
+	transfer->result[0] = result0;
+	transfer->result[1] = result1;
+	transfer->callback = NULL;
+	transfer->context = NULL;
+}
+
+static DAC7678_State DAC7678_commit(DAC7678 *device, const uint8_t count, DAC7678_Callback callback, void *context)
+{
+	DAC7678_Transfer *last = DAC7678_slot(device, count - 1);
+	last->callback = callback;
+	last->context = context;
+
+	if (device->m_transport->async)
+	{
+		// an idle bus is started here, a busy one chains to us from its completion interrupt
+		uint32_t primask = __get_PRIMASK();
+		__disable_irq();
+		device->m_queue_tail = (device->m_queue_tail + count) & DAC7678_QUEUE_MASK;
+		DAC7678_kick(device->m_bus);
+		__set_PRIMASK(primask);
+
+		return DAC7678_OK;
+	}
+
+	// blocking transports run the entries in place, the tail is never published
+	for (uint8_t i = 0; i < count; ++i)
+	{
+		DAC7678_Transfer *transfer = DAC7678_slot(device, i);
+
+		DAC7678_State state;
+		if (transfer->rx_size)
+		{
+			state = DAC7678_write_read(device, transfer->data[0], transfer->rx, transfer->rx_size);
+			if (state == DAC7678_OK && transfer->decode) transfer->decode(transfer->rx, transfer->result[0], transfer->result[1]);
+		}
+		else
+		{
+			state = DAC7678_transmit(device, transfer->data, transfer->size);
+		}
+		if (state != DAC7678_OK)
+		{
+			if (callback) callback(device, state, context);
+			return state;
+		}
+	}
+
+	if (callback) callback(device, DAC7678_OK, context);
+
+	return DAC7678_OK;
+}
+
+static DAC7678_State DAC7678_read_async(DAC7678 *device, const uint8_t command, DAC7678_Decoder decode, void *result0, void *result1, DAC7678_Callback callback, void *context)
+{
+	DAC7678_State state = DAC7678_reserve(device, 1);
+	if (state != DAC7678_OK) return state;
+
+	DAC7678_fill_read(DAC7678_slot(device, 0), command, decode, result0, result1);
+
+	return DAC7678_commit(device, 1, callback, context);
+}
+
+static void DAC7678_read_done(DAC7678 *device, const DAC7678_State state, void *context)
+{
+	(void)device;
+	*(volatile DAC7678_State *)context = state;
+}
+
+// blocking read built on the queue, decodes only after the receive has completed
+static DAC7678_State DAC7678_read(DAC7678 *device, const uint8_t command, DAC7678_Decoder decode, void *result0, void *result1)
+{
+	if (!device->m_transport->async)
+	{
+		DAC7678_State state = DAC7678_write_read(device, command, device->m_data_rx, 2);
+		if (state != DAC7678_OK) return state;
+
+		decode(device->m_data_rx, result0, result1);
+
+		return DAC7678_OK;
+	}
+
+	volatile DAC7678_State result = DAC7678_NONE;
+	const uint8_t slot = device->m_queue_tail;
+
+	DAC7678_State state = DAC7678_read_async(device, command, decode, result0, result1, DAC7678_read_done, (void *)&result);
+	if (state != DAC7678_OK) return state;
+
+	const uint32_t deadline = DAC7678_now_us() + device->m_timeout_us;
+	while (result == DAC7678_NONE)
+	{
+		// releases a retry held off, runs a pending re-init and watches for a stall
+		DAC7678_bus_service(device->m_bus);
+		if (DAC7678_expired(deadline))
+		{
+			// detach the entry from this stack frame before giving up on it
+			uint32_t primask = __get_PRIMASK();
+			__disable_irq();
+			if (result == DAC7678_NONE)
+			{
+				device->m_queue[slot].decode = NULL;
+				device->m_queue[slot].callback = NULL;
+			}
+			__set_PRIMASK(primask);
+			DAC7678_PERF_STATE(device, DAC7678_ERROR_TIMEOUT_RX);
+			return DAC7678_ERROR_TIMEOUT_RX;
+		}
+	}
+
+	return result;
+}
+
+static void DAC7678_decode_raw(const uint8_t *rx, void *raw, void *unused)
+{
+	(void)unused;
+	((uint8_t *)raw)[0] = rx[0];
+	((uint8_t *)raw)[1] = rx[1];
+}
+
+// config register getters answer from the mirror as the cache policy allows
+static DAC7678_State DAC7678_read_cached(DAC7678 *device, const uint8_t command, DAC7678_Decoder decode, void *result0, void *result1)
+{
+	const uint8_t reg = (uint8_t)((command >> 4) - 4);
+	const uint8_t cached = device->m_mirror_valid & (1 << reg);
+	uint8_t *mirror = device->m_mirror[reg];
+
+	switch (device->m_cache_policy)
+	{
+	case DAC7678_CACHE_ONLY:
+		if (!cached) return DAC7678_ERROR_NOT_CACHED;
+		device->cache_hits++;
+		decode(mirror, result0, result1);
+		return DAC7678_OK;
+	case DAC7678_CACHE_READ_THROUGH:
+		if (!cached) break;
+		device->cache_hits++;
+		decode(mirror, result0, result1);
+		return DAC7678_OK;
+	case DAC7678_CACHE_VERIFY:
+		if (!cached || (HAL_GetTick() - device->m_mirror_tick[reg] >= device->m_cache_period)) break;
+		device->cache_hits++;
+		decode(mirror, result0, result1);
+		return DAC7678_OK;
+	default:
+		break;
+	}
+
+	uint8_t raw[2];
+	DAC7678_State state = DAC7678_read(device, command, DAC7678_decode_raw, raw, NULL);
+	if (state != DAC7678_OK) return state;
+
+	// the part lost what we wrote, most likely a reset or brown-out; trust nothing else either
+	if (cached && ((raw[0] != mirror[0]) || (raw[1] != mirror[1])))
+	{
+		device->cache_mismatches++;
+		device->m_mirror_valid = 0;
+		device->m_shadow_valid = DAC7678_CHM_NONE;
+	}
+
+	mirror[0] = raw[0];
+	mirror[1] = raw[1];
+	device->m_mirror_tick[reg] = HAL_GetTick();
+	device->m_mirror_valid |= (uint8_t)(1 << reg);
+	decode(raw, result0, result1);
+
+	return DAC7678_OK;
+}
+
+static DAC7678_State DAC7678_read_reg(DAC7678 *device, const DAC7678_Reg reg, void *result0, void *result1)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+
+	return DAC7678_read_cached(device, s_registers[reg].command, s_registers[reg].decode, result0, result1);
+}
+
+static DAC7678_State DAC7678_read_reg_async(DAC7678 *device, const DAC7678_Reg reg, void *result0, void *result1, DAC7678_Callback callback, void *context)
+{
+	return DAC7678_read_async(device, s_registers[reg].command, s_registers[reg].decode, result0, result1, callback, context);
+}
+
+DAC7678_State DAC7678_set_cache_policy(DAC7678 *device, const DAC7678_CachePolicy policy, const uint32_t verify_period)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+
+	device->m_cache_policy = policy;
+	device->m_cache_period = verify_period;
+
+	return DAC7678_OK;
+}
+
+DAC7678_State DAC7678_set_timeout(DAC7678 *device, const uint32_t timeout_us)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+	if (timeout_us > 0x7FFFFFFFUL) return DAC7678_ERROR_INVALID_VALUE; // deadlines compare by signed difference
+
+	device->m_timeout_us = timeout_us;
+
+	return DAC7678_OK;
+}
+
+// update all rides on the last write, so the channels move together
+static DAC7678_State DAC7678_queue_channels(DAC7678 *device, const uint8_t channel_mask, const uint16_t *values, const uint8_t options, DAC7678_Callback callback, void *context)
+{
+	uint8_t count = 0;
+	uint8_t last = 0;
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (!(channel_mask & (1 << channel))) continue;
+		last = channel;
+		count++;
+	}
+
+	DAC7678_State state = DAC7678_reserve(device, count);
+	if (state != DAC7678_OK) return state;
+
+	const uint8_t command = (options == DAC7678_WRT_UPDATE_ALL) ? DAC7678_WRT_UPDATE_OFF : options;
+	uint8_t slot = 0;
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (!(channel_mask & (1 << channel))) continue;
+
+		const uint16_t code = DAC7678_calibrate(device, (DAC7678_ChannelIdx)channel, values[channel]);
+		DAC7678_fill_write(DAC7678_slot(device, slot++), (uint8_t)((channel == last ? options : command) | channel), (uint8_t)(code >> 4), (uint8_t)(code << 4));
+		DAC7678_shadow(device, channel, values[channel]);
+	}
+	device->writes_sent += count;
+
+	state = DAC7678_commit(device, count, callback, context);
+	if (state != DAC7678_OK) device->m_shadow_valid = DAC7678_CHM_NONE;
+
+	return state;
+}
+
+DAC7678_State DAC7678_set_value_async(DAC7678 *device, const DAC7678_ChannelIdx channel, const uint16_t value, DAC7678_Callback callback, void *context)
+{
+	if (value > DAC7678_MAX_VALUE) return DAC7678_ERROR_INVALID_VALUE;
+	if ((channel >= DAC7678_MAX_CHANNELS) && (channel != DAC7678_CH_ALL)) return DAC7678_ERROR_INVALID_CHANNEL;
+
+	if ((channel == DAC7678_CH_ALL) && device->m_cal_enabled)
+	{
+		// corrected codes differ per channel, so no broadcast
+		uint16_t values[DAC7678_MAX_CHANNELS];
+		for (uint8_t i = 0; i < DAC7678_MAX_CHANNELS; ++i)
+		{
+			values[i] = value;
+		}
+		const uint8_t latch = (device->m_write_options == DAC7678_WRT_UPDATE_OFF) ? DAC7678_WRT_UPDATE_OFF : DAC7678_WRT_UPDATE_ALL;
+		return DAC7678_queue_channels(device, DAC7678_CHM_ALL, values, latch, callback, context);
+	}
+
+	DAC7678_State state = DAC7678_reserve(device, 1);
+	if (state != DAC7678_OK) return state;
+
+	const uint16_t code = DAC7678_calibrate(device, channel, value);
+	DAC7678_fill_write(DAC7678_slot(device, 0), (uint8_t)(device->m_write_options | channel), (uint8_t)(code >> 4), (uint8_t)(code << 4));
+
+	// shadow first, a failure reported from the interrupt clears it again
+	DAC7678_shadow(device, channel, value);
+	device->writes_sent++;
+
+	state = DAC7678_commit(device, 1, callback, context);
+	if (state != DAC7678_OK) device->m_shadow_valid = DAC7678_CHM_NONE;
+
+	return state;
+}
+
+DAC7678_State DAC7678_set_units_async(DAC7678 *device, const DAC7678_ChannelIdx channel, const uint16_t units, DAC7678_Callback callback, void *context)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+	if (units >= device->m_full_scale) return DAC7678_ERROR_INVALID_VALUE;
+
+	return DAC7678_set_value_async(device, channel, DAC7678_units_to_code(units, device->m_unit_scale), callback, context);
+}
+
+DAC7678_State DAC7678_set_values_async(DAC7678 *device, DAC7678_Callback callback, void *context)
+{
+	return DAC7678_set_channels_async(device, DAC7678_CHM_ALL, callback, context);
+}
+
+DAC7678_State DAC7678_set_channels_async(DAC7678 *device, const DAC7678_ChannelMsk channel_mask, DAC7678_Callback callback, void *context)
+{
+	uint8_t equal = 1;
+	uint8_t count = 0;
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (!(channel_mask & (1 << channel))) continue;
+		if (device->values[channel] > DAC7678_MAX_VALUE) return DAC7678_ERROR_INVALID_VALUE;
+		if (device->values[channel] != device->values[0]) equal = 0;
+		count++;
+	}
+
+	if (count == 0) return DAC7678_ERROR_INVALID_CHANNEL;
+	if ((channel_mask == DAC7678_CHM_ALL) && equal && !device->m_cal_enabled) return DAC7678_set_value_async(device, DAC7678_CH_ALL, device->values[0], callback, context);
+
+	return DAC7678_queue_channels(device, (uint8_t)channel_mask, device->values, (uint8_t)device->m_write_options, callback, context);
+}
+
+DAC7678_State DAC7678_update_dac_reg_async(DAC7678 *device, const DAC7678_ChannelIdx channel, DAC7678_Callback callback, void *context)
+{
+	if ((channel >= DAC7678_MAX_CHANNELS) && (channel != DAC7678_CH_ALL)) return DAC7678_ERROR_INVALID_CHANNEL;
+
+	DAC7678_State state = DAC7678_reserve(device, 1);
+	if (state != DAC7678_OK) return state;
+
+	DAC7678_fill_write(DAC7678_slot(device, 0), (uint8_t)(DAC7678_CMD_UPDATE_DAC_REG | channel), 0x00, 0x00);
+
+	return DAC7678_commit(device, 1, callback, context);
+}
+
+DAC7678_State DAC7678_get_value_async(DAC7678 *device, const DAC7678_ChannelIdx channel, uint16_t *value, DAC7678_Callback callback, void *context)
+{
+	if (channel >= DAC7678_MAX_CHANNELS) return DAC7678_ERROR_INVALID_CHANNEL;
+
+	return DAC7678_read_async(device, (uint8_t)(DAC7678_CMD_READ_IN_REG | channel), DAC7678_decode_value, value, NULL, callback, context);
+}
+
+DAC7678_State DAC7678_get_dac_reg_async(DAC7678 *device, const DAC7678_ChannelIdx channel, uint16_t *value, DAC7678_Callback callback, void *context)
+{
+	if (channel >= DAC7678_MAX_CHANNELS) return DAC7678_ERROR_INVALID_CHANNEL;
+
+	return DAC7678_read_async(device, (uint8_t)(DAC7678_CMD_READ_DAC_REG | channel), DAC7678_decode_value, value, NULL, callback, context);
+}
+
+DAC7678_State DAC7678_get_power_reg_async(DAC7678 *device, DAC7678_PowerOptions *options, DAC7678_ChannelMsk *channel_mask, DAC7678_Callback callback, void *context)
+{
+	return DAC7678_read_reg_async(device, DAC7678_REG_POWER, options, channel_mask, callback, context);
+}
+
+DAC7678_State DAC7678_get_clear_reg_async(DAC7678 *device, DAC7678_ClearOptions *options, DAC7678_Callback callback, void *context)
+{
+	return DAC7678_read_reg_async(device, DAC7678_REG_CLEAR, options, NULL, callback, context);
+}
+
+DAC7678_State DAC7678_get_ldac_reg_async(DAC7678 *device, DAC7678_ChannelMsk *channel_mask, DAC7678_Callback callback, void *context)
+{
+	return DAC7678_read_reg_async(device, DAC7678_REG_LDAC, channel_mask, NULL, callback, context);
+}
+
+DAC7678_State DAC7678_get_int_ref_static_reg_async(DAC7678 *device, DAC7678_ReferenceStaticOptions *options, DAC7678_Callback callback, void *context)
+{
+	return DAC7678_read_reg_async(device, DAC7678_REG_REF_STATIC, options, NULL, callback, context);
+}
+
+DAC7678_State DAC7678_get_int_ref_flexi_reg_async(DAC7678 *device, DAC7678_ReferenceFlexiOptions *options, DAC7678_Callback callback, void *context)
+{
+	return DAC7678_read_reg_async(device, DAC7678_REG_REF_FLEXI, options, NULL, callback, context);
+}
+
+uint8_t DAC7678_queue_pending(DAC7678 *device)
+{
+	return (device->m_queue_tail - device->m_queue_head) & DAC7678_QUEUE_MASK;
 }
 
-DAC7678_State DAC7678_set_values(DAC7678 *device)
+DAC7678_State DAC7678_flush(DAC7678 *device)
 {
-	if (!s_init) return DAC7678_ERROR;
+	return DAC7678_flush_timeout(device, device->m_timeout_us);
+}
 
-	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
-	{
-		if (device->values[channel] > DAC7678_MAX_VALUE) return DAC7678_ERROR_INVALID_VALUE;
-	}
+DAC7678_State DAC7678_flush_timeout(DAC7678 *device, const uint32_t timeout_us)
+{
+	if (!device->m_init) return DAC7678_ERROR;
 
-	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	const uint32_t deadline = DAC7678_now_us() + timeout_us;
+	DAC7678_Bus *bus = device->m_bus;
+	while ((device->m_queue_head != device->m_queue_tail) || (bus->m_direct.size && (bus->m_direct.device == device)))
 	{
-		device->m_data_tx[0] = (uint8_t)(device->m_write_options | channel);
-		device->m_data_tx[1] = (uint8_t)(device->values[channel] >> 4);
-		device->m_data_tx[2] = (uint8_t)(device->values[channel] << 4);
-
-#ifdef DAC7678_INTERRUPTS
-		uint32_t timeout = HAL_GetTick() + DAC7678_TIMEOUT;
-		while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-		{
-			if (HAL_GetTick() > timeout) return DAC7678_ERROR_TIMEOUT_TX;
-		}
-		if (HAL_I2C_Master_Transmit_IT(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3) != HAL_OK)
-#else
-		if (HAL_I2C_Master_Transmit(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3, DAC7678_TIMEOUT) != HAL_OK)
-#endif
+		DAC7678_bus_service(bus);
+		if (DAC7678_expired(deadline))
 		{
-			return DAC7678_ERROR_TX;
+			DAC7678_PERF_STATE(device, DAC7678_ERROR_TIMEOUT_TX);
+			return DAC7678_ERROR_TIMEOUT_TX;
 		}
 	}
 
-	return DAC7678_OK;
+	return DAC7678_get_error(device);
 }
 
-DAC7678_State DAC7678_update_dac_reg(DAC7678 *device, const DAC7678_ChannelIdx channel)
+DAC7678_State DAC7678_get_error(DAC7678 *device)
 {
-	if (!s_init) return DAC7678_ERROR;
-	if (channel > DAC7678_MAX_CHANNELS) return DAC7678_ERROR_INVALID_CHANNEL;
+	const DAC7678_State state = device->m_error;
+	device->m_error = DAC7678_OK;
 
-	device->m_data_tx[0] = DAC7678_CMD_UPDATE_DAC_REG;
-	device->m_data_tx[1] = 0x00;
-	device->m_data_tx[2] = 0x00;
+	return state;
+}
 
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeout = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeout) return DAC7678_ERROR_TIMEOUT_TX;
-	}
-	if (HAL_I2C_Master_Transmit_IT(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Transmit(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3, DAC7678_TIMEOUT) != HAL_OK)
-#endif
-	{
-		return DAC7678_ERROR_TX;
-	}
+#ifdef DAC7678_PERF
+DAC7678_State DAC7678_perf_snapshot(DAC7678 *device, DAC7678_Perf *perf, const uint8_t reset)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	*perf = device->m_perf;
+	if (reset) device->m_perf = (DAC7678_Perf){ 0 };
+	__set_PRIMASK(primask);
 
 	return DAC7678_OK;
 }
 
-DAC7678_State DAC7678_set_power_reg(DAC7678 *device, const DAC7678_PowerOptions options, const DAC7678_ChannelMsk channel_mask)
+DAC7678_State DAC7678_perf_reset(DAC7678 *device)
 {
-	if (!s_init) return DAC7678_ERROR;
+	if (!device->m_init) return DAC7678_ERROR;
 
-	device->m_data_tx[0] = DAC7678_CMD_WRITE_PWR;
-	uint16_t channels = channel_mask << 5;
-	device->m_data_tx[1] = (uint8_t)((channels >> 8) | options);
-	device->m_data_tx[2] = (uint8_t)(channels & 0xFF);
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	device->m_perf = (DAC7678_Perf){ 0 };
+	__set_PRIMASK(primask);
 
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeout = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeout) return DAC7678_ERROR_TIMEOUT_TX;
-	}
-	if (HAL_I2C_Master_Transmit_IT(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Transmit(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3, DAC7678_TIMEOUT) != HAL_OK)
+	return DAC7678_OK;
+}
 #endif
+
+uint8_t DAC7678_bus_pending(DAC7678_Bus *bus)
+{
+	uint8_t pending = 0;
+	for (uint8_t i = 0; i < DAC7678_MAX_DEVICES; ++i)
 	{
-		return DAC7678_ERROR_TX;
+		if (bus->m_devices[i]) pending += DAC7678_queue_pending(bus->m_devices[i]);
 	}
 
-	return DAC7678_OK;
+	return pending;
 }
 
-DAC7678_State DAC7678_set_clear_reg(DAC7678 *device, const DAC7678_ClearOptions options)
+DAC7678_State DAC7678_bus_flush(DAC7678_Bus *bus)
 {
-	if (!s_init) return DAC7678_ERROR;
-
-	device->m_data_tx[0] = DAC7678_CMD_WRITE_CLR_CODE;
-	device->m_data_tx[1] = 0x00;
-	device->m_data_tx[2] = (uint8_t)options;
+	return DAC7678_bus_flush_timeout(bus, DAC7678_TIMEOUT_US);
+}
 
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeout = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeout) return DAC7678_ERROR_TIMEOUT_TX;
-	}
-	if (HAL_I2C_Master_Transmit_IT(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Transmit(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3, DAC7678_TIMEOUT) != HAL_OK)
-#endif
+DAC7678_State DAC7678_bus_flush_timeout(DAC7678_Bus *bus, const uint32_t timeout_us)
+{
+	const uint32_t deadline = DAC7678_now_us() + timeout_us;
+	while (DAC7678_bus_pending(bus))
 	{
-		return DAC7678_ERROR_TX;
+		DAC7678_bus_service(bus);
+		if (DAC7678_expired(deadline)) return DAC7678_ERROR_TIMEOUT_TX;
 	}
 
 	return DAC7678_OK;
 }
 
-DAC7678_State DAC7678_set_ldac_reg(DAC7678 *device, const DAC7678_ChannelMsk channel_mask)
+DAC7678_State DAC7678_bus_set_recovery(DAC7678_Bus *bus, DAC7678_BusClear bus_clear, const uint8_t retries)
 {
-	if (!s_init) return DAC7678_ERROR;
+	if (bus == NULL || bus->m_hi2c == NULL) return DAC7678_ERROR;
 
-	device->m_data_tx[0] = DAC7678_CMD_WRITE_LDAC;
-	device->m_data_tx[1] = (uint8_t)channel_mask;
-	device->m_data_tx[2] = 0x00;
-
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeout = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeout) return DAC7678_ERROR_TIMEOUT_TX;
-	}
-	if (HAL_I2C_Master_Transmit_IT(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Transmit(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3, DAC7678_TIMEOUT) != HAL_OK)
-#endif
-	{
-		return DAC7678_ERROR_TX;
-	}
+	bus->m_bus_clear = bus_clear;
+	bus->m_retries = retries;
 
 	return DAC7678_OK;
 }
 
-DAC7678_State DAC7678_set_int_ref_static_reg(DAC7678 *device, const DAC7678_ReferenceStaticOptions options)
+void DAC7678_bus_poll(DAC7678_Bus *bus)
 {
-	if (!s_init) return DAC7678_ERROR;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
 
-	device->m_data_tx[0] = DAC7678_CMD_WRITE_REF_STATIC;
-	device->m_data_tx[1] = 0x00;
-	device->m_data_tx[2] = (uint8_t)options;
-
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeout = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
+	const uint32_t now = DAC7678_now_us();
+	if (bus->m_recover)
 	{
-		if (HAL_GetTick() > timeout) return DAC7678_ERROR_TIMEOUT_TX;
+		// the re-init waits for DAC7678_bus_service, nothing starts until then
 	}
-	if (HAL_I2C_Master_Transmit_IT(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Transmit(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3, DAC7678_TIMEOUT) != HAL_OK)
-#endif
+	else if (bus->m_holdoff)
+	{
+		if ((int32_t)(now - bus->m_retry_at) >= 0)
+		{
+			bus->m_holdoff = 0;
+			const DAC7678_State state = DAC7678_restart(bus);
+			if (state != DAC7678_OK) DAC7678_give_up(bus, state);
+		}
+	}
+	else if (!bus->m_transport->async || bus->m_transport->is_ready(bus->m_hi2c) || (bus->m_progress != bus->m_watch_progress))
+	{
+		bus->m_watch_progress = bus->m_progress;
+		bus->m_watch_since = now;
+	}
+	else if ((now - bus->m_watch_since) >= DAC7678_STALL_TIMEOUT_US)
 	{
-		return DAC7678_ERROR_TX;
+		// no completion for a whole stall period: try a STOP first, re-init if that does not complete either
+		bus->m_watch_since = now;
+		const uint8_t address = bus->m_active ? bus->m_active->m_address : bus->m_direct.address;
+		if (!bus->m_aborting && (HAL_I2C_Master_Abort_IT(bus->m_hi2c, address << 1) == HAL_OK))
+		{
+			bus->m_aborting = 1;
+		}
+		else
+		{
+			DAC7678 *device = bus->m_active;
+			const uint8_t rx = device ? device->m_queue[device->m_queue_head].rx_size : 0;
+			DAC7678_fault(bus, rx ? DAC7678_ERROR_TIMEOUT_RX : DAC7678_ERROR_TIMEOUT_TX, 1);
+		}
 	}
 
-	return DAC7678_OK;
+	__set_PRIMASK(primask);
 }
 
-DAC7678_State DAC7678_set_int_ref_flexi_reg(DAC7678 *device, const DAC7678_ReferenceFlexiOptions options)
+void DAC7678_bus_service(DAC7678_Bus *bus)
 {
-	if (!s_init) return DAC7678_ERROR;
-
-	device->m_data_tx[0] = DAC7678_CMD_WRITE_REF_FLEX;
-	device->m_data_tx[1] = (uint8_t)options;
-	device->m_data_tx[2] = 0x00;
-
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeout = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeout) return DAC7678_ERROR_TIMEOUT_TX;
-	}
-	if (HAL_I2C_Master_Transmit_IT(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Transmit(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3, DAC7678_TIMEOUT) != HAL_OK)
-#endif
+	// DeInit, bus clear and Init run with interrupts enabled; nothing starts while the re-init is pending
+	if (bus->m_recover && (!bus->m_holdoff || ((int32_t)(DAC7678_now_us() - bus->m_retry_at) >= 0)))
 	{
-		return DAC7678_ERROR_TX;
+		DAC7678_recover(bus);
+		if (!bus->m_holdoff)
+		{
+			// the transfer was given up, the queues waited for the re-init
+			uint32_t primask = __get_PRIMASK();
+			__disable_irq();
+			DAC7678_kick(bus);
+			__set_PRIMASK(primask);
+		}
 	}
 
-	return DAC7678_OK;
+	DAC7678_bus_poll(bus);
 }
 
-DAC7678_State DAC7678_reset(DAC7678 *device, const DAC7678_ResetOptions options)
+DAC7678_State DAC7678_bus_update_dac_regs(DAC7678_Bus *bus)
 {
-	if (!s_init) return DAC7678_ERROR;
+	if (bus == NULL || bus->m_hi2c == NULL) return DAC7678_ERROR;
 
-	device->m_data_tx[0] = DAC7678_CMD_RESET;
-	device->m_data_tx[1] = (uint8_t)options;
-	device->m_data_tx[2] = 0x00;
+	// the frame may still be on the wire from the last group update
+	DAC7678_State state = DAC7678_wait_ready(bus, NULL, bus->m_transport, DAC7678_deadline(NULL), DAC7678_ERROR_TIMEOUT_TX);
+	if (state != DAC7678_OK) return state;
 
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeout = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeout) return DAC7678_ERROR_TIMEOUT_TX;
-	}
-	if (HAL_I2C_Master_Transmit_IT(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Transmit(device->m_hi2c, device->m_address << 1, device->m_data_tx, 3, DAC7678_TIMEOUT) != HAL_OK)
-#endif
-	{
-		return DAC7678_ERROR_TX;
-	}
+	bus->m_broadcast[0] = (uint8_t)(DAC7678_CMD_UPDATE_DAC_REG | DAC7678_CH_ALL);
+	bus->m_broadcast[1] = 0x00;
+	bus->m_broadcast[2] = 0x00;
 
-	return DAC7678_OK;
+	state = DAC7678_transmit_to(bus, NULL, bus->m_transport, DAC7678_BROADCAST_ADDRESS, bus->m_broadcast, 3);
+	if (!bus->m_transport->async) DAC7678_sync_done(bus);
+
+	return state;
 }
 
-DAC7678_State DAC7678_get_value(DAC7678 *device, const DAC7678_ChannelIdx channel, uint16_t *value)
+DAC7678_State DAC7678_bus_set_values(DAC7678_Bus *bus)
 {
-	if (!s_init) return DAC7678_ERROR;
-	if (channel > DAC7678_MAX_CHANNELS) return DAC7678_ERROR_INVALID_CHANNEL;
+	if (bus == NULL || bus->m_hi2c == NULL) return DAC7678_ERROR;
 
-	device->m_data_tx[0] = (uint8_t)(DAC7678_CMD_READ_IN_REG | channel);
-
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeoutTx = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeoutTx) return DAC7678_ERROR_TIMEOUT_TX;
-	}
-	if (HAL_I2C_Master_Transmit_IT(device->m_hi2c, device->m_address << 1, device->m_data_tx, 1) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Transmit(device->m_hi2c, device->m_address << 1, device->m_data_tx, 1, DAC7678_TIMEOUT) != HAL_OK)
-#endif
+	// load only, outputs stay put until the broadcast latches every chip at once
+	for (uint8_t i = 0; i < DAC7678_MAX_DEVICES; ++i)
 	{
-		return DAC7678_ERROR_TX;
-	}
+		if (bus->m_devices[i] == NULL) continue;
 
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeoutRx = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeoutRx) return DAC7678_ERROR_TIMEOUT_RX;
-	}
-	if (HAL_I2C_Master_Receive_IT(device->m_hi2c, device->m_address << 1, device->m_data_rx, 2) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Receive(device->m_hi2c, device->m_address << 1, device->m_data_rx, 2, DAC7678_TIMEOUT) != HAL_OK)
-#endif
-	{
-		return DAC7678_ERROR_RX;
+		DAC7678_State state = DAC7678_set_values_dirty(bus->m_devices[i], DAC7678_WRT_UPDATE_OFF);
+		if (state != DAC7678_OK) return state;
 	}
 
-	uint16_t result = 0;
-	result |= (uint16_t)(device->m_data_rx[0] << 4);
-	result |= (uint16_t)(device->m_data_rx[1] >> 4);
-	*value = result;
-
-	return DAC7678_OK;
+	return DAC7678_bus_update_dac_regs(bus);
 }
 
-DAC7678_State DAC7678_get_dac_reg(DAC7678 *device, const DAC7678_ChannelIdx channel, uint16_t *value)
+// software reset of every chip on the bus through the broadcast address
+static DAC7678_State DAC7678_bus_reset(DAC7678_Bus *bus, const DAC7678_ResetOptions options)
 {
-	if (!s_init) return DAC7678_ERROR;
-	if (channel > DAC7678_MAX_CHANNELS) return DAC7678_ERROR_INVALID_CHANNEL;
+	DAC7678_State state = DAC7678_bus_flush(bus);
+	if (state != DAC7678_OK) return state;
 
-	device->m_data_tx[0] = (uint8_t)(DAC7678_CMD_READ_DAC_REG | channel);
+	state = DAC7678_wait_ready(bus, NULL, bus->m_transport, DAC7678_deadline(NULL), DAC7678_ERROR_TIMEOUT_TX);
+	if (state != DAC7678_OK) return state;
 
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeoutTx = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeoutTx) return DAC7678_ERROR_TIMEOUT_TX;
-	}
-	if (HAL_I2C_Master_Transmit_IT(device->m_hi2c, device->m_address << 1, device->m_data_tx, 1) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Transmit(device->m_hi2c, device->m_address << 1, device->m_data_tx, 1, DAC7678_TIMEOUT) != HAL_OK)
-#endif
+	for (uint8_t i = 0; i < DAC7678_MAX_DEVICES; ++i)
 	{
-		return DAC7678_ERROR_TX;
-	}
+		if (bus->m_devices[i] == NULL) continue;
 
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeoutRx = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeoutRx) return DAC7678_ERROR_TIMEOUT_RX;
-	}
-	if (HAL_I2C_Master_Receive_IT(device->m_hi2c, device->m_address << 1, device->m_data_rx, 2) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Receive(device->m_hi2c, device->m_address << 1, device->m_data_rx, 2, DAC7678_TIMEOUT) != HAL_OK)
-#endif
-	{
-		return DAC7678_ERROR_RX;
+		bus->m_devices[i]->m_shadow_valid = DAC7678_CHM_NONE;
+		bus->m_devices[i]->m_mirror_valid = 0;
 	}
 
-	uint16_t result = 0;
-	result |= (uint16_t)(device->m_data_rx[0] << 4);
-	result |= (uint16_t)(device->m_data_rx[1] >> 4);
-	*value = result;
+	bus->m_broadcast[0] = s_registers[DAC7678_REG_RESET].command;
+	s_registers[DAC7678_REG_RESET].encode(bus->m_broadcast, (uint8_t)options, 0);
 
-	return DAC7678_OK;
+	state = DAC7678_transmit_to(bus, NULL, bus->m_transport, DAC7678_BROADCAST_ADDRESS, bus->m_broadcast, 3);
+	if (state != DAC7678_OK) return state;
+
+	// the clock may only change once the reset is off the wire
+	return DAC7678_wait_ready(bus, NULL, bus->m_transport, DAC7678_deadline(NULL), DAC7678_ERROR_TIMEOUT_TX);
 }
 
-DAC7678_State DAC7678_get_power_reg(DAC7678 *device, DAC7678_PowerOptions *options, DAC7678_ChannelMsk *channel_mask)
+DAC7678_State DAC7678_bus_hs_enter(DAC7678_Bus *bus, DAC7678_ClockHook clock)
 {
-	if (!s_init) return DAC7678_ERROR;
-
-	device->m_data_tx[0] = DAC7678_CMD_READ_PWR;
-
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeoutTx = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeoutTx) return DAC7678_ERROR_TIMEOUT_TX;
-	}
-	if (HAL_I2C_Master_Transmit_IT(device->m_hi2c, device->m_address << 1, device->m_data_tx, 1) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Transmit(device->m_hi2c, device->m_address << 1, device->m_data_tx, 1, DAC7678_TIMEOUT) != HAL_OK)
-#endif
-	{
-		return DAC7678_ERROR_TX;
-	}
+	if (bus == NULL || bus->m_hi2c == NULL || clock == NULL) return DAC7678_ERROR;
+	if (bus->m_clock) return DAC7678_OK;
 
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeoutRx = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeoutRx) return DAC7678_ERROR_TIMEOUT_RX;
-	}
-	if (HAL_I2C_Master_Receive_IT(device->m_hi2c, device->m_address << 1, device->m_data_rx, 2) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Receive(device->m_hi2c, device->m_address << 1, device->m_data_rx, 2, DAC7678_TIMEOUT) != HAL_OK)
-#endif
+	// the master code switches the chips to Hs-mode for one transaction,
+	// the reset it carries keeps them there after STOP
+	clock(bus->m_hi2c, DAC7678_SPEED_HS_MASTER_CODE);
+	DAC7678_State state = DAC7678_bus_reset(bus, DAC7678_RST_SET_HS_MODE);
+	if (state != DAC7678_OK)
 	{
-		return DAC7678_ERROR_RX;
+		clock(bus->m_hi2c, DAC7678_SPEED_FAST);
+		return state;
 	}
 
-	*options = (DAC7678_PowerOptions)(device->m_data_rx[0] << 5);
-	*channel_mask = (DAC7678_ChannelMsk)(device->m_data_rx[1]);
+	clock(bus->m_hi2c, DAC7678_SPEED_HS);
+	bus->m_clock = clock;
+	if (!bus->m_transport->async) DAC7678_sync_done(bus);
 
 	return DAC7678_OK;
 }
 
-DAC7678_State DAC7678_get_clear_reg(DAC7678 *device, DAC7678_ClearOptions *options)
+DAC7678_State DAC7678_bus_hs_exit(DAC7678_Bus *bus)
 {
-	if (!s_init) return DAC7678_ERROR;
+	if (bus == NULL || bus->m_hi2c == NULL) return DAC7678_ERROR;
+	if (bus->m_clock == NULL) return DAC7678_OK;
 
-	device->m_data_tx[0] = DAC7678_CMD_READ_CLR_CODE;
+	// a power-on reset returns the chips to F/S-mode
+	DAC7678_State state = DAC7678_bus_reset(bus, DAC7678_RST);
+	bus->m_clock(bus->m_hi2c, DAC7678_SPEED_FAST);
+	bus->m_clock = NULL;
+	if (!bus->m_transport->async) DAC7678_sync_done(bus);
 
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeoutTx = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeoutTx) return DAC7678_ERROR_TIMEOUT_TX;
-	}
-	if (HAL_I2C_Master_Transmit_IT(device->m_hi2c, device->m_address << 1, device->m_data_tx, 1) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Transmit(device->m_hi2c, device->m_address << 1, device->m_data_tx, 1, DAC7678_TIMEOUT) != HAL_OK)
-#endif
-	{
-		return DAC7678_ERROR_TX;
-	}
+	return state;
+}
 
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeoutRx = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeoutRx) return DAC7678_ERROR_TIMEOUT_RX;
-	}
-	if (HAL_I2C_Master_Receive_IT(device->m_hi2c, device->m_address << 1, device->m_data_rx, 2) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Receive(device->m_hi2c, device->m_address << 1, device->m_data_rx, 2, DAC7678_TIMEOUT) != HAL_OK)
-#endif
-	{
-		return DAC7678_ERROR_RX;
-	}
+uint8_t DAC7678_bus_hs_active(const DAC7678_Bus *bus)
+{
+	return bus->m_clock != NULL;
+}
 
-	*options = (DAC7678_ClearOptions)(device->m_data_rx[1] << 4);
+void DAC7678_i2c_tx_cplt(I2C_HandleTypeDef *hi2c)
+{
+	DAC7678_bus_done(hi2c, DAC7678_OK);
+}
 
-	return DAC7678_OK;
+void DAC7678_i2c_rx_cplt(I2C_HandleTypeDef *hi2c)
+{
+	DAC7678_bus_done(hi2c, DAC7678_OK);
 }
 
-DAC7678_State DAC7678_get_ldac_reg(DAC7678 *device, DAC7678_ChannelMsk *channel_mask)
+void DAC7678_i2c_error(I2C_HandleTypeDef *hi2c)
 {
-	if (!s_init) return DAC7678_ERROR;
+	DAC7678_Bus *bus = DAC7678_get_bus(hi2c);
+	if (bus == NULL) return;
 
-	device->m_data_tx[0] = DAC7678_CMD_READ_LDAC;
+	DAC7678 *device = bus->m_active;
+	const uint8_t rx = device ? device->m_queue[device->m_queue_head].rx_size : 0;
+	const DAC7678_State state = DAC7678_hal_error(hi2c, HAL_ERROR, rx);
 
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeoutTx = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeoutTx) return DAC7678_ERROR_TIMEOUT_TX;
-	}
-	if (HAL_I2C_Master_Transmit_IT(device->m_hi2c, device->m_address << 1, device->m_data_tx, 1) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Transmit(device->m_hi2c, device->m_address << 1, device->m_data_tx, 1, DAC7678_TIMEOUT) != HAL_OK)
-#endif
-	{
-		return DAC7678_ERROR_TX;
-	}
+	DAC7678_fault(bus, state, DAC7678_needs_recovery(state));
+}
 
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeoutRx = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeoutRx) return DAC7678_ERROR_TIMEOUT_RX;
-	}
-	if (HAL_I2C_Master_Receive_IT(device->m_hi2c, device->m_address << 1, device->m_data_rx, 2) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Receive(device->m_hi2c, device->m_address << 1, device->m_data_rx, 2, DAC7678_TIMEOUT) != HAL_OK)
-#endif
-	{
-		return DAC7678_ERROR_RX;
-	}
+// an abort started by DAC7678_bus_poll has put a STOP on the wire, the peripheral is usable again
+void DAC7678_i2c_abort_cplt(I2C_HandleTypeDef *hi2c)
+{
+	DAC7678_Bus *bus = DAC7678_get_bus(hi2c);
+	if (bus == NULL || !bus->m_aborting) return;
 
-	*channel_mask = (DAC7678_ChannelMsk)(device->m_data_rx[1]);
+	bus->m_aborting = 0;
+	DAC7678 *device = bus->m_active;
+	const uint8_t rx = device ? device->m_queue[device->m_queue_head].rx_size : 0;
 
-	return DAC7678_OK;
+	DAC7678_fault(bus, rx ? DAC7678_ERROR_TIMEOUT_RX : DAC7678_ERROR_TIMEOUT_TX, 0);
 }
 
-DAC7678_State DAC7678_get_int_ref_static_reg(DAC7678 *device, DAC7678_ReferenceStaticOptions *options)
+// blocking getters, timed under DAC7678_PERF
+static DAC7678_State DAC7678_get_channel(DAC7678 *device, const uint8_t command, const DAC7678_ChannelIdx channel, uint16_t *value)
 {
-	if (!s_init) return DAC7678_ERROR;
+	if (!device->m_init) return DAC7678_ERROR;
+	if (channel >= DAC7678_MAX_CHANNELS) return DAC7678_ERROR_INVALID_CHANNEL;
 
-	device->m_data_tx[0] = DAC7678_CMD_READ_REF_STATIC;
+	DAC7678_PERF_BEGIN();
+	const DAC7678_State state = DAC7678_read(device, (uint8_t)(command | channel), DAC7678_decode_value, value, NULL);
+	DAC7678_PERF_END(device, DAC7678_PERF_GET);
 
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeoutTx = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeoutTx) return DAC7678_ERROR_TIMEOUT_TX;
-	}
-	if (HAL_I2C_Master_Transmit_IT(device->m_hi2c, device->m_address << 1, device->m_data_tx, 1) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Transmit(device->m_hi2c, device->m_address << 1, device->m_data_tx, 1, DAC7678_TIMEOUT) != HAL_OK)
-#endif
-	{
-		return DAC7678_ERROR_TX;
-	}
+	return state;
+}
 
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeoutRx = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeoutRx) return DAC7678_ERROR_TIMEOUT_RX;
-	}
-	if (HAL_I2C_Master_Receive_IT(device->m_hi2c, device->m_address << 1, device->m_data_rx, 2) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Receive(device->m_hi2c, device->m_address << 1, device->m_data_rx, 2, DAC7678_TIMEOUT) != HAL_OK)
-#endif
-	{
-		return DAC7678_ERROR_RX;
-	}
+static DAC7678_State DAC7678_get_reg(DAC7678 *device, const DAC7678_Reg reg, void *result0, void *result1)
+{
+	DAC7678_PERF_BEGIN();
+	const DAC7678_State state = DAC7678_read_reg(device, reg, result0, result1);
+	DAC7678_PERF_END(device, DAC7678_PERF_GET);
 
-	*options = (DAC7678_ReferenceStaticOptions)(device->m_data_rx[1] << 4);
+	return state;
+}
 
-	return DAC7678_OK;
+DAC7678_State DAC7678_get_value(DAC7678 *device, const DAC7678_ChannelIdx channel, uint16_t *value)
+{
+	return DAC7678_get_channel(device, DAC7678_CMD_READ_IN_REG, channel, value);
 }
 
-DAC7678_State DAC7678_get_int_ref_flexi_reg(DAC7678 *device, DAC7678_ReferenceFlexiOptions *options)
+DAC7678_State DAC7678_get_dac_reg(DAC7678 *device, const DAC7678_ChannelIdx channel, uint16_t *value)
 {
-	if (!s_init) return DAC7678_ERROR;
+	return DAC7678_get_channel(device, DAC7678_CMD_READ_DAC_REG, channel, value);
+}
 
-	device->m_data_tx[0] = DAC7678_CMD_READ_REF_FLEX;
+DAC7678_State DAC7678_get_power_reg(DAC7678 *device, DAC7678_PowerOptions *options, DAC7678_ChannelMsk *channel_mask)
+{
+	return DAC7678_get_reg(device, DAC7678_REG_POWER, options, channel_mask);
+}
 
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeoutTx = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeoutTx) return DAC7678_ERROR_TIMEOUT_TX;
-	}
-	if (HAL_I2C_Master_Transmit_IT(device->m_hi2c, device->m_address << 1, device->m_data_tx, 1) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Transmit(device->m_hi2c, device->m_address << 1, device->m_data_tx, 1, DAC7678_TIMEOUT) != HAL_OK)
-#endif
-	{
-		return DAC7678_ERROR_TX;
-	}
+DAC7678_State DAC7678_get_clear_reg(DAC7678 *device, DAC7678_ClearOptions *options)
+{
+	return DAC7678_get_reg(device, DAC7678_REG_CLEAR, options, NULL);
+}
 
-#ifdef DAC7678_INTERRUPTS
-	uint32_t timeoutRx = HAL_GetTick() + DAC7678_TIMEOUT;
-	while (device->m_hi2c->State != HAL_I2C_STATE_READY)
-	{
-		if (HAL_GetTick() > timeoutRx) return DAC7678_ERROR_TIMEOUT_RX;
-	}
-	if (HAL_I2C_Master_Receive_IT(device->m_hi2c, device->m_address << 1, device->m_data_rx, 2) != HAL_OK)
-#else
-	if (HAL_I2C_Master_Receive(device->m_hi2c, device->m_address << 1, device->m_data_rx, 2, DAC7678_TIMEOUT) != HAL_OK)
-#endif
-	{
-		return DAC7678_ERROR_RX;
-	}
+DAC7678_State DAC7678_get_ldac_reg(DAC7678 *device, DAC7678_ChannelMsk *channel_mask)
+{
+	return DAC7678_get_reg(device, DAC7678_REG_LDAC, channel_mask, NULL);
+}
 
-	*options = (DAC7678_ReferenceFlexiOptions)(device->m_data_rx[0] >> 1);
+DAC7678_State DAC7678_get_int_ref_static_reg(DAC7678 *device, DAC7678_ReferenceStaticOptions *options)
+{
+	return DAC7678_get_reg(device, DAC7678_REG_REF_STATIC, options, NULL);
+}
 
-	return DAC7678_OK;
+DAC7678_State DAC7678_get_int_ref_flexi_reg(DAC7678 *device, DAC7678_ReferenceFlexiOptions *options)
+{
+	return DAC7678_get_reg(device, DAC7678_REG_REF_FLEXI, options, NULL);
 }
 
 #ifdef DAC7678_TEST
@@ -1130,6 +2436,86 @@ DAC7678_Test test_wr_values(DAC7678 *device)
 	return DAC7678_TST_PASS;
 }
 
+DAC7678_Test test_wr_value_burst(DAC7678 *device)
+{
+	DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_ON);
+
+	uint16_t valuesW[DAC7678_MAX_BURST];
+	uint16_t valueR = 0;
+	for (uint8_t i = 0; i < DAC7678_MAX_BURST; ++i)
+	{
+		valuesW[i] = (uint16_t)(100 + i * 300);
+	}
+
+	if (DAC7678_set_value_burst(device, DAC7678_CH_E, valuesW, DAC7678_MAX_BURST) != DAC7678_OK)
+	{
+		return DAC7678_TST_FAIL;
+	}
+	if (DAC7678_get_dac_reg(device, DAC7678_CH_E, &valueR) != DAC7678_OK)
+	{
+		return DAC7678_TST_FAIL;
+	}
+	if (valuesW[DAC7678_MAX_BURST - 1] != valueR) return DAC7678_TST_FAIL;
+
+	return DAC7678_TST_PASS;
+}
+
+DAC7678_Test test_wr_values_dirty(DAC7678 *device)
+{
+	uint16_t valueR = 0;
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		device->values[channel] = (uint16_t)(500 + channel);
+	}
+	if (DAC7678_set_values_dirty(device, DAC7678_WRT_UPDATE_ALL) != DAC7678_OK) return DAC7678_TST_FAIL;
+
+	// channel 8 is neither a channel nor DAC7678_CH_ALL, it must not reach the shadow
+	const uint8_t shadow_valid = device->m_shadow_valid;
+	if (DAC7678_set_value(device, DAC7678_MAX_CHANNELS, 123) != DAC7678_ERROR_INVALID_CHANNEL) return DAC7678_TST_FAIL;
+	if (DAC7678_set_value_async(device, DAC7678_MAX_CHANNELS, 123, NULL, NULL) != DAC7678_ERROR_INVALID_CHANNEL) return DAC7678_TST_FAIL;
+	if (DAC7678_get_value(device, DAC7678_MAX_CHANNELS, &valueR) != DAC7678_ERROR_INVALID_CHANNEL) return DAC7678_TST_FAIL;
+	if (device->m_shadow_valid != shadow_valid) return DAC7678_TST_FAIL;
+	const uint32_t unchanged = device->writes_sent;
+	if (DAC7678_set_values_dirty(device, DAC7678_WRT_UPDATE_ALL) != DAC7678_OK || device->writes_sent != unchanged) return DAC7678_TST_FAIL;
+
+	// only the changed channel goes out, and it updates all DAC registers
+	const uint32_t sent = device->writes_sent;
+	device->values[2] = 2000;
+	if (DAC7678_set_values_dirty(device, DAC7678_WRT_UPDATE_ALL) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (device->writes_sent - sent != 1) return DAC7678_TST_FAIL;
+
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (DAC7678_get_dac_reg(device, channel, &valueR) != DAC7678_OK) return DAC7678_TST_FAIL;
+		if (valueR != device->values[channel]) return DAC7678_TST_FAIL;
+	}
+
+	return DAC7678_TST_PASS;
+}
+
+DAC7678_Test test_wr_cache(DAC7678 *device)
+{
+	DAC7678_ChannelMsk maskR = DAC7678_CHM_NONE;
+
+	// the mirror must agree with the bus before it may stand in for it
+	DAC7678_set_cache_policy(device, DAC7678_CACHE_OFF, 0);
+	if (DAC7678_set_ldac_reg(device, DAC7678_CHM_B | DAC7678_CHM_G) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_get_ldac_reg(device, &maskR) != DAC7678_OK) return DAC7678_TST_FAIL;
+
+	const uint32_t hits = device->cache_hits;
+	const uint32_t mismatches = device->cache_mismatches;
+	DAC7678_set_cache_policy(device, DAC7678_CACHE_ONLY, 0);
+	maskR = DAC7678_CHM_NONE;
+	if (DAC7678_get_ldac_reg(device, &maskR) != DAC7678_OK) return DAC7678_TST_FAIL;
+	DAC7678_set_cache_policy(device, DAC7678_CACHE_OFF, 0);
+
+	if (maskR != (DAC7678_CHM_B | DAC7678_CHM_G)) return DAC7678_TST_FAIL;
+	if (device->cache_hits != hits + 1) return DAC7678_TST_FAIL;
+	if (device->cache_mismatches != mismatches) return DAC7678_TST_FAIL;
+
+	return DAC7678_set_ldac_reg(device, DAC7678_CHM_NONE) == DAC7678_OK ? DAC7678_TST_PASS : DAC7678_TST_FAIL;
+}
+
 void test_run_all(DAC7678 *dac)
 {
 	printf("testing all...\r\n");
@@ -1186,6 +2572,21 @@ void test_run_all(DAC7678 *dac)
 	{
 		printf("test 9 failed\r\n");
 	}
+
+	if (test_wr_value_burst(dac) != DAC7678_TST_PASS)
+	{
+		printf("test 10 failed\r\n");
+	}
+
+	if (test_wr_values_dirty(dac) != DAC7678_TST_PASS)
+	{
+		printf("test 11 failed\r\n");
+	}
+
+	if (test_wr_cache(dac) != DAC7678_TST_PASS)
+	{
+		printf("test 12 failed\r\n");
+	}
 }
 
 #endif
@@ -15,12 +15,48 @@ extern "C" {
 #include "main.h"
 
 #define DAC7678_TIMEOUT 		100 // ms
+#define DAC7678_TIMEOUT_US		(DAC7678_TIMEOUT * 1000UL) // default per device, DAC7678_set_timeout
+#define DAC7678_STALL_TIMEOUT_US	5000 // without a completion before a bus is recovered
+#define DAC7678_BACKOFF_US		1000 // before the second restart of a failed transfer, doubled for each later one
+#define DAC7678_RETRIES			2 // restarts of a failed transfer, default per bus
 #define DAC7678_MAX_VALUE 		4095
 #define DAC7678_MAX_CHANNELS	8
+#define DAC7678_MAX_BURST		8 // samples per DAC7678_set_value_burst transaction
+#define DAC7678_MAX_DEVICES		8 // per bus, one for each address pin combination
+#define DAC7678_MAX_BUSES		2 // I2C handles with DAC7678s on them
+#define DAC7678_BROADCAST_ADDRESS	0x47 // every DAC7678 on the bus, write only
+#define DAC7678_TX_FRAMES		2 // setter TX frames per device, ping-pong
+#define DAC7678_QUEUE_SIZE		16 // async transfers per device, power of two
+#define DAC7678_MIRROR_REGS		6 // power, clear, LDAC, (reset), static and flexi reference
+#define DAC7678_CAL_INL_MAX_BITS	8 // INL tables up to 256 segments
+
+#define DAC7678_VREF_INTERNAL_MV	2500 // full scale with the internal reference
+
+// Q16 codes per unit: code = units * scale >> 16, units <= full scale keeps the product below 2^28
+#define DAC7678_UNIT_SCALE(full_scale)	((uint32_t)(((4096UL << 16) + (full_scale) / 2) / (full_scale)))
+
+// Q16 calibration constants, e.g. DAC7678_CAL_Q16(1.0123)
+#define DAC7678_CAL_Q16(x)		((int32_t)((x) * 65536.0 + ((x) < 0 ? -0.5 : 0.5)))
 
 //#define DAC7678_TEST		// toggle tests
 
+#ifndef DAC7678_BLOCKING
 #define DAC7678_INTERRUPTS // toggle interrupts
+#endif
+
+//#define DAC7678_DMA		// toggle DMA, takes precedence over DAC7678_INTERRUPTS
+
+//#define DAC7678_PERF		// toggle per-device counters and latency histograms
+//#define DAC7678_TRACE		// toggle the frame trace ring, see DAC7678_trace.h
+
+// transport DAC7678_init picks; DAC7678_init_transport chooses per device
+#if defined(DAC7678_DMA)
+#define DAC7678_TRANSPORT_DEFAULT (&DAC7678_TRANSPORT_DMA)
+#elif defined(DAC7678_INTERRUPTS)
+#define DAC7678_TRANSPORT_DEFAULT (&DAC7678_TRANSPORT_IT)
+#else
+#define DAC7678_TRANSPORT_DEFAULT (&DAC7678_TRANSPORT_BLOCKING)
+#endif
 
 #ifdef DAC7678_TEST
 typedef enum
@@ -42,6 +78,11 @@ typedef enum
 	DAC7678_ERROR_INVALID_CHANNEL	= 5,
 	DAC7678_ERROR_TIMEOUT_TX		= 6,
 	DAC7678_ERROR_TIMEOUT_RX		= 7,
+	DAC7678_ERROR_QUEUE_FULL		= 8,
+	DAC7678_ERROR_NOT_CACHED		= 9,
+	DAC7678_ERROR_NACK				= 10,
+	DAC7678_ERROR_ARBITRATION		= 11,
+	DAC7678_ERROR_BUS				= 12,
 } DAC7678_State;
 
 typedef enum
@@ -143,21 +184,203 @@ typedef enum
 	DAC7678_RST_KEEP_HS_MODE	= 0x80,
 } DAC7678_ResetOptions;
 
+typedef enum
+{
+	DAC7678_CACHE_NONE			= -1,
+	DAC7678_CACHE_OFF			= 0, // always read the bus
+	DAC7678_CACHE_ONLY			= 1, // never read the bus, DAC7678_ERROR_NOT_CACHED until written
+	DAC7678_CACHE_READ_THROUGH	= 2, // read the bus only for registers not yet written or read
+	DAC7678_CACHE_VERIFY		= 3, // as read through, but re-read once the verify period has passed
+} DAC7678_CachePolicy;
+
+typedef struct DAC7678 DAC7678;
+
+// NOTE: addresses are 7-bit; async transports report completion through DAC7678_i2c_tx_cplt / rx_cplt / error
+typedef struct
+{
+	DAC7678_State	(*transmit)(I2C_HandleTypeDef *hi2c, const uint8_t address, uint8_t *data, const uint16_t size);
+	DAC7678_State	(*write_read)(I2C_HandleTypeDef *hi2c, const uint8_t address, const uint8_t command, uint8_t *data, const uint16_t size); // command, repeated START, receive
+	uint8_t			(*is_ready)(I2C_HandleTypeDef *hi2c);
+	uint8_t			async; // transfers run on after the call returns
+} DAC7678_Transport;
+
+extern const DAC7678_Transport DAC7678_TRANSPORT_BLOCKING;
+extern const DAC7678_Transport DAC7678_TRANSPORT_IT;
+extern const DAC7678_Transport DAC7678_TRANSPORT_DMA;
+
+typedef enum
+{
+	DAC7678_SPEED_FAST				= 0, // F/S-mode, up to 400 kHz
+	DAC7678_SPEED_HS_MASTER_CODE	= 1, // Hs-mode, master code sent in F/S-mode ahead of every transaction
+	DAC7678_SPEED_HS				= 2, // Hs-mode straight after START, every chip on the bus held in Hs-mode
+} DAC7678_Speed;
+
+// NOTE: reprograms the I2C controller; the HAL has no Hs-mode API, so this is board specific
+typedef void (*DAC7678_ClockHook)(I2C_HandleTypeDef *hi2c, const DAC7678_Speed speed);
+
+// NOTE: board specific; with the pins as GPIO, pulse SCL until SDA reads high (9 pulses at most), then send a STOP
+typedef void (*DAC7678_BusClear)(I2C_HandleTypeDef *hi2c);
+
+// NOTE: free-running microseconds that wrap at 2^32 (a 32-bit timer at 1 MHz); deadlines compare by signed difference
+typedef uint32_t (*DAC7678_TimeSource)(void);
+
+// a transfer started outside the queues, kept so an error can restart it
+typedef struct
+{
+	DAC7678					*device; // NULL for a broadcast
+	const DAC7678_Transport	*transport;
+	uint8_t					*data;
+	uint16_t				size; // 0: none in flight
+	uint8_t					address;
+} DAC7678_Direct;
+
+// NOTE: one per I2C handle, claimed by DAC7678_init; runs the queues of its devices back to back
+typedef struct
+{
+	I2C_HandleTypeDef		*m_hi2c;
+	const DAC7678_Transport	*m_transport; // of the first device, used for broadcasts
+	uint8_t					m_mixed; // devices use different transports
+	DAC7678					*m_devices[DAC7678_MAX_DEVICES];
+	DAC7678 * volatile		m_active; // owner of the queued transfer on the wire
+	uint8_t					m_next; // round robin start
+	uint8_t					m_broadcast[3];
+	DAC7678_ClockHook		m_clock; // set while an Hs-mode session is open
+	DAC7678_Direct			m_direct;
+	DAC7678_BusClear		m_bus_clear;
+	uint8_t					m_retries;
+	uint8_t					m_attempt; // restarts of the transfer on the wire
+	volatile uint8_t		m_holdoff; // a failed transfer waits for m_retry_at
+	uint8_t					m_aborting;
+	volatile uint8_t		m_recover; // an interrupt asked for a re-init, DAC7678_bus_service runs it
+	uint32_t				m_retry_at; // us
+	uint32_t				m_hal_timeout_ms; // of the blocking HAL call in progress, what is left of its deadline
+	volatile uint32_t		m_progress; // completions and errors, watched for stalls
+	uint32_t				m_watch_progress;
+	uint32_t				m_watch_since; // us
+	uint32_t				retries; // transfers restarted after an error
+	uint32_t				recoveries; // peripheral re-inits, with a bus clear when one is set
+} DAC7678_Bus;
+
+// NOTE: code = value * gain + offset, then minus the INL error interpolated at that code
+typedef struct
+{
+	int32_t			gain; // Q16, 0 .. 2.0
+	int32_t			offset; // Q16 codes
+	const int16_t	*inl; // 2^inl_bits + 1 errors in 1/16 LSB, evenly spaced over 0 .. 4096, or NULL
+	uint8_t			inl_bits;
+} DAC7678_Calibration;
+
+// NOTE: called from the I2C interrupt
+typedef void (*DAC7678_Callback)(DAC7678 *device, const DAC7678_State state, void *context);
+
+// NOTE: unpacks a 2 byte readback into the caller's result pointers
+typedef void (*DAC7678_Decoder)(const uint8_t *rx, void *result0, void *result1);
+
+typedef struct
+{
+	uint8_t				data[3];
+	uint8_t				size;
+	uint8_t				rx[2];
+	uint8_t				rx_size; // non-zero: register read, command byte sent as the Mem_Read address
+	DAC7678_Decoder		decode;
+	void				*result[2];
+	DAC7678_Callback	callback;
+	void				*context;
+} DAC7678_Transfer;
+
+#ifdef DAC7678_PERF
+#define DAC7678_PERF_BUCKETS	16 // bucket 0: below 1 us, bucket n: 2^(n-1) .. 2^n - 1 us, the last one open ended
+
+typedef enum
+{
+	DAC7678_PERF_SET_VALUE	= 0,
+	DAC7678_PERF_SET_VALUES	= 1,
+	DAC7678_PERF_GET		= 2, // every blocking getter
+	DAC7678_PERF_CALLS		= 3,
+} DAC7678_PerfCall;
+
+// NOTE: plain increments, from the caller and the I2C interrupt; a count can be lost when one preempts the other
 typedef struct
+{
+	uint32_t	transactions; // started on the bus, restarts included
+	uint32_t	bytes; // on the wire, address bytes included
+	uint32_t	retries;
+	uint32_t	timeouts; // waits that expired and transfers that timed out
+	uint32_t	writes_elided;
+	uint32_t	spin_us; // waiting for the I2C handle to become ready
+	uint32_t	latency[DAC7678_PERF_CALLS][DAC7678_PERF_BUCKETS]; // calls per log2 of their duration in us
+} DAC7678_Perf;
+#endif
+
+struct DAC7678
 {
 	I2C_HandleTypeDef		*m_hi2c;
+	DAC7678_Bus				*m_bus;
+	const DAC7678_Transport	*m_transport;
+	uint8_t					m_init;
 	uint8_t					m_address;
 	DAC7678_WriteOptions	m_write_options;
 	uint16_t				values[8]; // A, B, C, D, E, F, G, H respectively
-	uint8_t					m_data_tx[4];
+	uint8_t					m_frame[DAC7678_TX_FRAMES][3]; // staged while the previous frame is on the wire
+	uint8_t					m_frame_idx;
+	uint8_t					m_data_burst[1 + 2 * DAC7678_MAX_BURST];
+	uint16_t				m_shadow[8]; // last value written to each input register
+	uint8_t					m_shadow_valid; // DAC7678_ChannelMsk of channels m_shadow is known for
+	uint32_t				writes_sent; // channel writes put on the bus
+	uint32_t				writes_elided; // channel writes DAC7678_set_values_dirty skipped
+	uint8_t					m_mirror[DAC7678_MIRROR_REGS][2]; // config registers in readback format
+	uint8_t					m_mirror_valid;
+	uint32_t				m_mirror_tick[DAC7678_MIRROR_REGS]; // HAL_GetTick() of the last write or read
+	DAC7678_CachePolicy		m_cache_policy;
+	uint32_t				m_cache_period; // ms
+	uint32_t				m_timeout_us; // bound of each blocking call
+	uint32_t				cache_hits; // config getters answered without bus traffic
+	uint32_t				cache_mismatches; // verify reads that disagreed with the mirror
+	DAC7678_Calibration		m_cal[8];
+	uint8_t					m_cal_enabled; // DAC7678_ChannelMsk of calibrated channels
+	uint16_t				m_full_scale; // units at code 4096, mV of the reference by default
+	uint32_t				m_unit_scale; // DAC7678_UNIT_SCALE(m_full_scale)
 	uint8_t					m_data_rx[4];
-} DAC7678;
+	volatile DAC7678_State	m_error; // last direct async transfer that failed, DAC7678_OK if none
+#ifdef DAC7678_PERF
+	DAC7678_Perf			m_perf;
+#endif
+	DAC7678_Transfer		m_queue[DAC7678_QUEUE_SIZE];
+	volatile uint8_t		m_queue_head; // in flight while m_bus->m_active points here
+	volatile uint8_t		m_queue_tail;
+};
+
+// NOTE: the transfer was tried on the bus and failed, as opposed to refused before it started
+static inline uint8_t DAC7678_bus_error(const DAC7678_State state)
+{
+	return (state == DAC7678_ERROR_TX) || (state == DAC7678_ERROR_RX) ||
+			(state == DAC7678_ERROR_TIMEOUT_TX) || (state == DAC7678_ERROR_TIMEOUT_RX) ||
+			(state == DAC7678_ERROR_NACK) || (state == DAC7678_ERROR_ARBITRATION) || (state == DAC7678_ERROR_BUS);
+}
+
+// NOTE: scale from DAC7678_UNIT_SCALE, a constant folds the whole conversion to a multiply and a shift
+static inline uint16_t DAC7678_units_to_code(const uint16_t units, const uint32_t scale)
+{
+	const uint32_t code = ((uint32_t)units * scale + 0x8000) >> 16;
+
+	return (code > DAC7678_MAX_VALUE) ? DAC7678_MAX_VALUE : (uint16_t)code;
+}
+
+static inline uint16_t DAC7678_code_to_units(const uint16_t code, const uint16_t full_scale)
+{
+	return (uint16_t)(((uint32_t)code * full_scale + 2048) >> 12);
+}
 
 DAC7678_State DAC7678_init(DAC7678 *device, I2C_HandleTypeDef *hi2c, const uint8_t address);
+// NOTE: devices sharing an I2C handle should share a transport; mixing works, but a blocking call can lose a race with a queued start
+DAC7678_State DAC7678_init_transport(DAC7678 *device, I2C_HandleTypeDef *hi2c, const uint8_t address, const DAC7678_Transport *transport);
+// NOTE: DAC7678_ERROR while transfers of the device are queued or on the wire, flush first
 DAC7678_State DAC7678_deinit(DAC7678 *device);
 DAC7678_State DAC7678_set_write_options(DAC7678 *device, const DAC7678_WriteOptions options);
 DAC7678_State DAC7678_set_value(DAC7678 *device, const DAC7678_ChannelIdx channel_idx, const uint16_t value);
 DAC7678_State DAC7678_set_values(DAC7678 *device);
+DAC7678_State DAC7678_set_values_dirty(DAC7678 *device, const DAC7678_WriteOptions options); // NOTE: only channels whose values[] changed
+DAC7678_State DAC7678_set_value_burst(DAC7678 *device, const DAC7678_ChannelIdx channel_idx, const uint16_t *values, const uint8_t count);
 DAC7678_State DAC7678_update_dac_reg(DAC7678 *device, const DAC7678_ChannelIdx channel_idx);
 DAC7678_State DAC7678_set_power_reg(DAC7678 *device, const DAC7678_PowerOptions options, const DAC7678_ChannelMsk channel_mask);
 DAC7678_State DAC7678_set_clear_reg(DAC7678 *device, const DAC7678_ClearOptions options);
@@ -165,6 +388,73 @@ DAC7678_State DAC7678_set_ldac_reg(DAC7678 *device, const DAC7678_ChannelMsk cha
 DAC7678_State DAC7678_set_int_ref_static_reg(DAC7678 *device, const DAC7678_ReferenceStaticOptions options);
 DAC7678_State DAC7678_set_int_ref_flexi_reg(DAC7678 *device, const DAC7678_ReferenceFlexiOptions options);
 DAC7678_State DAC7678_reset(DAC7678 *device, const DAC7678_ResetOptions options);
+DAC7678_State DAC7678_set_cache_policy(DAC7678 *device, const DAC7678_CachePolicy policy, const uint32_t verify_period);
+// NOTE: a bus that stays busy longer fails the call with a timeout state; a 3-byte write takes about 100 us at 400 kHz
+// NOTE: bounds each blocking call: the wait for a busy bus, the retries and, on the blocking transport, the HAL call in whole ms
+DAC7678_State DAC7678_set_timeout(DAC7678 *device, const uint32_t timeout_us);
+// NOTE: values[] and setters stay in ideal codes, calibrated channels are corrected on the way out; getters read back chip codes
+DAC7678_State DAC7678_set_calibration(DAC7678 *device, const DAC7678_ChannelIdx channel_idx, const int32_t gain, const int32_t offset);
+DAC7678_State DAC7678_set_inl(DAC7678 *device, const DAC7678_ChannelIdx channel_idx, const int16_t *table, const uint8_t inl_bits);
+DAC7678_State DAC7678_clear_calibration(DAC7678 *device, const DAC7678_ChannelMsk channel_mask);
+uint16_t DAC7678_calibrate(const DAC7678 *device, const DAC7678_ChannelIdx channel_idx, const uint16_t value);
+// NOTE: units are mV of the reference, or whatever the output stage scales them to (uA behind a V/I stage)
+DAC7678_State DAC7678_set_full_scale(DAC7678 *device, const uint16_t full_scale);
+DAC7678_State DAC7678_set_units(DAC7678 *device, const DAC7678_ChannelIdx channel_idx, const uint16_t units);
+
+// NOTE: return once queued, callback reports the result
+DAC7678_State DAC7678_set_value_async(DAC7678 *device, const DAC7678_ChannelIdx channel_idx, const uint16_t value, DAC7678_Callback callback, void *context);
+DAC7678_State DAC7678_set_values_async(DAC7678 *device, DAC7678_Callback callback, void *context);
+DAC7678_State DAC7678_set_channels_async(DAC7678 *device, const DAC7678_ChannelMsk channel_mask, DAC7678_Callback callback, void *context);
+DAC7678_State DAC7678_set_units_async(DAC7678 *device, const DAC7678_ChannelIdx channel_idx, const uint16_t units, DAC7678_Callback callback, void *context);
+DAC7678_State DAC7678_update_dac_reg_async(DAC7678 *device, const DAC7678_ChannelIdx channel_idx, DAC7678_Callback callback, void *context);
+DAC7678_State DAC7678_get_value_async(DAC7678 *device, const DAC7678_ChannelIdx channel_idx, uint16_t *value, DAC7678_Callback callback, void *context);
+DAC7678_State DAC7678_get_dac_reg_async(DAC7678 *device, const DAC7678_ChannelIdx channel_idx, uint16_t *value, DAC7678_Callback callback, void *context);
+DAC7678_State DAC7678_get_power_reg_async(DAC7678 *device, DAC7678_PowerOptions *options, DAC7678_ChannelMsk *channel_mask, DAC7678_Callback callback, void *context);
+DAC7678_State DAC7678_get_clear_reg_async(DAC7678 *device, DAC7678_ClearOptions *options, DAC7678_Callback callback, void *context);
+DAC7678_State DAC7678_get_ldac_reg_async(DAC7678 *device, DAC7678_ChannelMsk *channel_mask, DAC7678_Callback callback, void *context);
+DAC7678_State DAC7678_get_int_ref_static_reg_async(DAC7678 *device, DAC7678_ReferenceStaticOptions *options, DAC7678_Callback callback, void *context);
+DAC7678_State DAC7678_get_int_ref_flexi_reg_async(DAC7678 *device, DAC7678_ReferenceFlexiOptions *options, DAC7678_Callback callback, void *context);
+uint8_t DAC7678_queue_pending(DAC7678 *device);
+// NOTE: also reports, once, a direct async write that failed since the last flush or DAC7678_get_error
+DAC7678_State DAC7678_flush(DAC7678 *device);
+DAC7678_State DAC7678_flush_timeout(DAC7678 *device, const uint32_t timeout_us);
+DAC7678_State DAC7678_get_error(DAC7678 *device);
+DAC7678_Bus *DAC7678_get_bus(I2C_HandleTypeDef *hi2c);
+uint8_t DAC7678_bus_pending(DAC7678_Bus *bus);
+DAC7678_State DAC7678_bus_flush(DAC7678_Bus *bus);
+DAC7678_State DAC7678_bus_flush_timeout(DAC7678_Bus *bus, const uint32_t timeout_us);
+DAC7678_State DAC7678_bus_set_recovery(DAC7678_Bus *bus, DAC7678_BusClear bus_clear, const uint8_t retries);
+// NOTE: restarts transfers after their backoff and aborts stalled ones; the blocking calls poll while they wait,
+// fire-and-forget async users call it from a periodic interrupt below the I2C priority
+void DAC7678_bus_poll(DAC7678_Bus *bus);
+// NOTE: thread context only; runs a pending peripheral re-init with the bus clear hook, then polls.
+// A bus that needs one holds its transfers until this runs, call it from the main loop
+void DAC7678_bus_service(DAC7678_Bus *bus);
+
+// NOTE: shared by every bus; NULL falls back to HAL_GetTick() * 1000, which has 1 ms resolution
+void DAC7678_set_time_source(DAC7678_TimeSource now_us);
+uint32_t DAC7678_now_us(void);
+
+#ifdef DAC7678_PERF
+// NOTE: copies the counters with interrupts masked; reset clears them in the same section, so polls miss no event
+DAC7678_State DAC7678_perf_snapshot(DAC7678 *device, DAC7678_Perf *perf, const uint8_t reset);
+DAC7678_State DAC7678_perf_reset(DAC7678 *device);
+#endif
+
+// NOTE: load every attached chip's changed values[], then latch all of them with one broadcast update
+DAC7678_State DAC7678_bus_set_values(DAC7678_Bus *bus);
+DAC7678_State DAC7678_bus_update_dac_regs(DAC7678_Bus *bus);
+
+// NOTE: Hs-mode session; entering and leaving both reset every chip on the bus, so open it right after init
+DAC7678_State DAC7678_bus_hs_enter(DAC7678_Bus *bus, DAC7678_ClockHook clock);
+DAC7678_State DAC7678_bus_hs_exit(DAC7678_Bus *bus);
+uint8_t DAC7678_bus_hs_active(const DAC7678_Bus *bus);
+
+// NOTE: call from HAL_I2C_MasterTxCpltCallback, HAL_I2C_MemRxCpltCallback, HAL_I2C_ErrorCallback and HAL_I2C_AbortCpltCallback
+void DAC7678_i2c_tx_cplt(I2C_HandleTypeDef *hi2c);
+void DAC7678_i2c_rx_cplt(I2C_HandleTypeDef *hi2c);
+void DAC7678_i2c_error(I2C_HandleTypeDef *hi2c);
+void DAC7678_i2c_abort_cplt(I2C_HandleTypeDef *hi2c);
 
 DAC7678_State DAC7678_get_value(DAC7678 *device, const DAC7678_ChannelIdx channel_idx, uint16_t *value);
 DAC7678_State DAC7678_get_dac_reg(DAC7678 *device, const DAC7678_ChannelIdx channel_idx, uint16_t *value);
@@ -186,6 +476,9 @@ DAC7678_Test test_wr_power_register(DAC7678 *device);
 DAC7678_Test test_wr_clear_register(DAC7678 *device);
 DAC7678_Test test_wr_ldac_register(DAC7678 *device);
 DAC7678_Test test_wr_values(DAC7678 *device);
+DAC7678_Test test_wr_value_burst(DAC7678 *device);
+DAC7678_Test test_wr_values_dirty(DAC7678 *device);
+DAC7678_Test test_wr_cache(DAC7678 *device);
 void test_run_all(DAC7678 *device);
 #endif
 
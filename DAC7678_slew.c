@@ -0,0 +1,145 @@
+/*
+ * DAC7678_slew.c
+ */
+
+#include "DAC7678_slew.h"
+
+DAC7678_State DAC7678_slew_init(DAC7678_Slew *slew, DAC7678 *device)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+
+	slew->m_device = device;
+	slew->m_active = DAC7678_CHM_NONE;
+	slew->m_pending = DAC7678_CHM_NONE;
+	slew->m_finishing.m_finished = DAC7678_CHM_NONE;
+	slew->m_landing_head = 0;
+	slew->m_landing_tail = 0;
+	slew->ticks = 0;
+	slew->dropped = 0;
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		slew->m_channels[channel].m_target = device->values[channel];
+		slew->m_channels[channel].m_rate = 0;
+		slew->m_channels[channel].m_callback = NULL;
+		slew->m_channels[channel].m_context = NULL;
+	}
+
+	// every tick loads the moving channels and latches them together with its last write
+	return DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_ALL);
+}
+
+DAC7678_State DAC7678_slew_to(DAC7678_Slew *slew, const DAC7678_ChannelIdx channel, const uint16_t target, const uint16_t rate, DAC7678_SlewCallback callback, void *context)
+{
+	if (channel >= DAC7678_MAX_CHANNELS) return DAC7678_ERROR_INVALID_CHANNEL;
+	if ((target > DAC7678_MAX_VALUE) || (rate == 0)) return DAC7678_ERROR_INVALID_VALUE;
+
+	// the tick may be mid ramp on this channel
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	DAC7678_SlewChannel *sc = &slew->m_channels[channel];
+	sc->m_target = target;
+	sc->m_rate = rate;
+	sc->m_callback = callback;
+	sc->m_context = context;
+	slew->m_active |= (uint8_t)(1 << channel);
+	__set_PRIMASK(primask);
+
+	return DAC7678_OK;
+}
+
+DAC7678_State DAC7678_slew_stop(DAC7678_Slew *slew, const DAC7678_ChannelMsk channel_mask)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	slew->m_active &= (uint8_t)~channel_mask;
+	__set_PRIMASK(primask);
+
+	return DAC7678_OK;
+}
+
+uint8_t DAC7678_slew_busy(const DAC7678_Slew *slew)
+{
+	return slew->m_active;
+}
+
+static void DAC7678_slew_landed(DAC7678 *device, const DAC7678_State state, void *context)
+{
+	(void)device;
+	DAC7678_Slew *slew = (DAC7678_Slew *)context;
+
+	// transfers retire in order, so the oldest landing belongs to this write
+	const uint8_t tail = slew->m_landing_tail;
+	const DAC7678_SlewLanding *landing = &slew->m_landing[tail];
+
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (!(landing->m_finished & (1 << channel))) continue;
+
+		if (landing->m_callback[channel]) landing->m_callback[channel](slew, (DAC7678_ChannelIdx)channel, state, landing->m_context[channel]);
+	}
+	slew->m_landing_tail = (uint8_t)((tail + 1) & (DAC7678_SLEW_LANDINGS - 1));
+}
+
+void DAC7678_slew_tick(DAC7678_Slew *slew)
+{
+	DAC7678 *device = slew->m_device;
+	const uint8_t active = slew->m_active;
+	uint8_t moved = slew->m_pending;
+	uint8_t finished = DAC7678_CHM_NONE;
+	DAC7678_SlewLanding *finishing = &slew->m_finishing;
+
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (!(active & (1 << channel))) continue;
+
+		const DAC7678_SlewChannel *sc = &slew->m_channels[channel];
+		const uint16_t value = device->values[channel];
+		if (value < sc->m_target)
+		{
+			device->values[channel] = (sc->m_target - value > sc->m_rate) ? (uint16_t)(value + sc->m_rate) : sc->m_target;
+		}
+		else if (value > sc->m_target)
+		{
+			device->values[channel] = (value - sc->m_target > sc->m_rate) ? (uint16_t)(value - sc->m_rate) : sc->m_target;
+		}
+
+		moved |= (uint8_t)(1 << channel);
+
+		// a ramp that finished on a dropped tick still waits for its write, this one finishes on the next tick
+		if ((device->values[channel] == sc->m_target) && !(finishing->m_finished & (1 << channel)))
+		{
+			finished |= (uint8_t)(1 << channel);
+			finishing->m_finished |= (uint8_t)(1 << channel);
+			finishing->m_callback[channel] = sc->m_callback;
+			finishing->m_context[channel] = sc->m_context;
+		}
+	}
+
+	slew->m_active &= (uint8_t)~finished;
+	if (moved == DAC7678_CHM_NONE) return;
+
+	// one submission per tick, latched by the update all on its last write
+	DAC7678_Callback callback = NULL;
+	const uint8_t head = slew->m_landing_head;
+	if (finishing->m_finished != DAC7678_CHM_NONE)
+	{
+		slew->m_landing[head] = *finishing;
+		slew->m_landing_head = (uint8_t)((head + 1) & (DAC7678_SLEW_LANDINGS - 1));
+		callback = DAC7678_slew_landed;
+	}
+
+	// blocking builds report a failed write through the callback, like a completed one
+	const DAC7678_State state = DAC7678_set_channels_async(device, (DAC7678_ChannelMsk)moved, callback, slew);
+	if ((state != DAC7678_OK) && !DAC7678_bus_error(state))
+	{
+		// nothing was queued; keep the positions, the next tick writes them
+		slew->m_landing_head = head;
+		slew->m_pending = moved;
+		slew->dropped++;
+		return;
+	}
+
+	slew->m_pending = DAC7678_CHM_NONE;
+	finishing->m_finished = DAC7678_CHM_NONE;
+	slew->ticks++;
+}
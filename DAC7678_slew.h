@@ -0,0 +1,64 @@
+/*
+ * DAC7678_slew.h
+ */
+
+#ifndef DAC7678_SLEW_H_
+#define DAC7678_SLEW_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "DAC7678.h"
+
+#define DAC7678_SLEW_LANDINGS	DAC7678_QUEUE_SIZE // ticks with finishing ramps in flight, power of two
+
+typedef struct DAC7678_Slew DAC7678_Slew;
+
+// NOTE: called from the I2C interrupt once the write carrying the target is done
+typedef void (*DAC7678_SlewCallback)(DAC7678_Slew *slew, const DAC7678_ChannelIdx channel_idx, const DAC7678_State state, void *context);
+
+typedef struct
+{
+	uint16_t				m_target;
+	uint16_t				m_rate; // codes per tick
+	DAC7678_SlewCallback	m_callback;
+	void					*m_context;
+} DAC7678_SlewChannel;
+
+// NOTE: the callbacks are copied when the ramps finish, a channel may be retargeted before the write lands
+typedef struct
+{
+	uint8_t					m_finished; // DAC7678_ChannelMsk
+	DAC7678_SlewCallback	m_callback[DAC7678_MAX_CHANNELS];
+	void					*m_context[DAC7678_MAX_CHANNELS];
+} DAC7678_SlewLanding;
+
+struct DAC7678_Slew
+{
+	DAC7678				*m_device;
+	DAC7678_SlewChannel	m_channels[DAC7678_MAX_CHANNELS];
+	volatile uint8_t	m_active; // DAC7678_ChannelMsk of ramps still moving
+	uint8_t				m_pending; // moved on a dropped tick, written on the next one
+	DAC7678_SlewLanding	m_finishing; // reached the target on a dropped tick
+	DAC7678_SlewLanding	m_landing[DAC7678_SLEW_LANDINGS]; // finished ramps of queued ticks, in bus order
+	volatile uint8_t	m_landing_head;
+	volatile uint8_t	m_landing_tail;
+	uint32_t			ticks; // ticks that queued a write
+	uint32_t			dropped; // ticks lost to a full transfer queue
+};
+
+// NOTE: ramps start from device->values[], set them or write the outputs first
+DAC7678_State DAC7678_slew_init(DAC7678_Slew *slew, DAC7678 *device);
+DAC7678_State DAC7678_slew_to(DAC7678_Slew *slew, const DAC7678_ChannelIdx channel_idx, const uint16_t target, const uint16_t rate, DAC7678_SlewCallback callback, void *context);
+DAC7678_State DAC7678_slew_stop(DAC7678_Slew *slew, const DAC7678_ChannelMsk channel_mask); // NOTE: holds the current output, no callback
+uint8_t DAC7678_slew_busy(const DAC7678_Slew *slew); // DAC7678_ChannelMsk of moving channels
+
+// NOTE: call from the tick timer interrupt; while ramping the engine is the device's only queue producer
+void DAC7678_slew_tick(DAC7678_Slew *slew);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DAC7678_SLEW_H_ */
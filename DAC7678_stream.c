@@ -0,0 +1,170 @@
+/*
+ * DAC7678_stream.c
+ */
+
+#include "DAC7678_stream.h"
+
+DAC7678_State DAC7678_stream_init(DAC7678_Stream *stream, DAC7678 *device, const DAC7678_StreamMode mode, DAC7678_StreamCallback callback, void *context)
+{
+	if (!device->m_init) return DAC7678_ERROR;
+
+	stream->m_device = device;
+	stream->m_enabled = DAC7678_CHM_NONE;
+	stream->m_mode = mode;
+	stream->m_callback = callback;
+	stream->m_context = context;
+	stream->ticks = 0;
+	stream->dropped = 0;
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		DAC7678_StreamChannel *sc = &stream->m_channels[channel];
+		sc->m_buffer = NULL;
+		sc->m_mask = 0;
+		sc->m_head = 0;
+		sc->m_tail = 0;
+		sc->m_watermark = 0;
+		sc->underruns = 0;
+		sc->overruns = 0;
+	}
+
+	// every tick loads the playing channels and latches them together with its last write
+	return DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_ALL);
+}
+
+DAC7678_State DAC7678_stream_set_buffer(DAC7678_Stream *stream, const DAC7678_ChannelIdx channel, uint16_t *buffer, const uint16_t length, const uint16_t watermark)
+{
+	if (channel >= DAC7678_MAX_CHANNELS) return DAC7678_ERROR_INVALID_CHANNEL;
+	if (stream->m_enabled & (1 << channel)) return DAC7678_ERROR;
+	if ((buffer == NULL) || (length < 2) || (length > 0x8000) || (length & (length - 1))) return DAC7678_ERROR_INVALID_VALUE;
+	if (watermark >= length) return DAC7678_ERROR_INVALID_VALUE;
+
+	DAC7678_StreamChannel *sc = &stream->m_channels[channel];
+	sc->m_buffer = buffer;
+	sc->m_mask = (uint16_t)(length - 1);
+	sc->m_head = 0;
+	sc->m_tail = 0;
+	sc->m_watermark = watermark;
+
+	return DAC7678_OK;
+}
+
+DAC7678_State DAC7678_stream_set_mode(DAC7678_Stream *stream, const DAC7678_StreamMode mode)
+{
+	if ((mode != DAC7678_STREAM_FREE) && (mode != DAC7678_STREAM_LOCKSTEP)) return DAC7678_ERROR_INVALID_VALUE;
+
+	stream->m_mode = mode;
+
+	return DAC7678_OK;
+}
+
+DAC7678_State DAC7678_stream_start(DAC7678_Stream *stream, const DAC7678_ChannelMsk channel_mask)
+{
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if ((channel_mask & (1 << channel)) && (stream->m_channels[channel].m_buffer == NULL)) return DAC7678_ERROR_INVALID_CHANNEL;
+	}
+
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	stream->m_enabled |= (uint8_t)channel_mask;
+	__set_PRIMASK(primask);
+
+	return DAC7678_OK;
+}
+
+DAC7678_State DAC7678_stream_stop(DAC7678_Stream *stream, const DAC7678_ChannelMsk channel_mask)
+{
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	stream->m_enabled &= (uint8_t)~channel_mask;
+	__set_PRIMASK(primask);
+
+	return DAC7678_OK;
+}
+
+uint16_t DAC7678_stream_push(DAC7678_Stream *stream, const DAC7678_ChannelIdx channel, const uint16_t *samples, const uint16_t count)
+{
+	if ((channel >= DAC7678_MAX_CHANNELS) || (stream->m_channels[channel].m_buffer == NULL)) return 0;
+
+	DAC7678_StreamChannel *sc = &stream->m_channels[channel];
+	uint16_t head = sc->m_head;
+	const uint16_t space = (uint16_t)(sc->m_mask + 1 - (uint16_t)(head - sc->m_tail));
+
+	uint16_t pushed = 0;
+	while ((pushed < count) && (pushed < space))
+	{
+		if (samples[pushed] > DAC7678_MAX_VALUE) break;
+		sc->m_buffer[head & sc->m_mask] = samples[pushed++];
+		head++;
+	}
+	if (pushed == space) sc->overruns += (uint32_t)(count - pushed);
+
+	// samples land before the tick can see the new head
+	__DMB();
+	sc->m_head = head;
+
+	return pushed;
+}
+
+uint16_t DAC7678_stream_level(const DAC7678_Stream *stream, const DAC7678_ChannelIdx channel)
+{
+	if (channel >= DAC7678_MAX_CHANNELS) return 0;
+
+	const DAC7678_StreamChannel *sc = &stream->m_channels[channel];
+
+	return (uint16_t)(sc->m_head - sc->m_tail);
+}
+
+void DAC7678_stream_tick(DAC7678_Stream *stream)
+{
+	DAC7678 *device = stream->m_device;
+	const uint8_t enabled = stream->m_enabled;
+	if (enabled == DAC7678_CHM_NONE) return;
+
+	// peek first, the samples are only taken once the write is queued
+	uint8_t ready = DAC7678_CHM_NONE;
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (!(enabled & (1 << channel))) continue;
+
+		DAC7678_StreamChannel *sc = &stream->m_channels[channel];
+		if (sc->m_head == sc->m_tail)
+		{
+			sc->underruns++;
+			continue;
+		}
+		ready |= (uint8_t)(1 << channel);
+	}
+
+	if ((ready == DAC7678_CHM_NONE) || ((stream->m_mode == DAC7678_STREAM_LOCKSTEP) && (ready != enabled))) return;
+
+	__DMB();
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (!(ready & (1 << channel))) continue;
+
+		const DAC7678_StreamChannel *sc = &stream->m_channels[channel];
+		device->values[channel] = sc->m_buffer[sc->m_tail & sc->m_mask];
+	}
+
+	// blocking builds report a failed write like a completed one, the samples are spent either way
+	const DAC7678_State state = DAC7678_set_channels_async(device, (DAC7678_ChannelMsk)ready, NULL, NULL);
+	if ((state != DAC7678_OK) && !DAC7678_bus_error(state))
+	{
+		stream->dropped++;
+		return;
+	}
+	stream->ticks++;
+
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (!(ready & (1 << channel))) continue;
+
+		DAC7678_StreamChannel *sc = &stream->m_channels[channel];
+		const uint16_t tail = (uint16_t)(sc->m_tail + 1);
+		sc->m_tail = tail;
+
+		const uint16_t level = (uint16_t)(sc->m_head - tail);
+		if ((level == sc->m_watermark) && stream->m_callback) stream->m_callback(stream, (DAC7678_ChannelIdx)channel, level, stream->m_context);
+	}
+}
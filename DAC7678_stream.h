@@ -0,0 +1,66 @@
+/*
+ * DAC7678_stream.h
+ */
+
+#ifndef DAC7678_STREAM_H_
+#define DAC7678_STREAM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "DAC7678.h"
+
+typedef enum
+{
+	DAC7678_STREAM_FREE		= 0, // channels drain on their own, an empty one holds its output
+	DAC7678_STREAM_LOCKSTEP	= 1, // a tick plays only when every enabled channel has a sample
+} DAC7678_StreamMode;
+
+typedef struct DAC7678_Stream DAC7678_Stream;
+
+// NOTE: called from the tick interrupt when a channel drains to its watermark
+typedef void (*DAC7678_StreamCallback)(DAC7678_Stream *stream, const DAC7678_ChannelIdx channel_idx, const uint16_t level, void *context);
+
+// NOTE: single producer (push) and single consumer (tick), indices run free and wrap
+typedef struct
+{
+	uint16_t			*m_buffer;
+	uint16_t			m_mask; // length - 1
+	volatile uint16_t	m_head; // written by the producer only
+	volatile uint16_t	m_tail; // written by the tick only
+	uint16_t			m_watermark;
+	uint32_t			underruns; // ticks the channel had nothing to play
+	uint32_t			overruns; // samples refused by a full ring
+} DAC7678_StreamChannel;
+
+struct DAC7678_Stream
+{
+	DAC7678					*m_device;
+	DAC7678_StreamChannel	m_channels[DAC7678_MAX_CHANNELS];
+	volatile uint8_t		m_enabled; // DAC7678_ChannelMsk
+	DAC7678_StreamMode		m_mode;
+	DAC7678_StreamCallback	m_callback;
+	void					*m_context;
+	uint32_t				ticks; // ticks that queued a write
+	uint32_t				dropped; // ticks retried after a full transfer queue
+};
+
+DAC7678_State DAC7678_stream_init(DAC7678_Stream *stream, DAC7678 *device, const DAC7678_StreamMode mode, DAC7678_StreamCallback callback, void *context);
+// NOTE: buffer length is a power of two up to 32768; the channel must be stopped
+DAC7678_State DAC7678_stream_set_buffer(DAC7678_Stream *stream, const DAC7678_ChannelIdx channel_idx, uint16_t *buffer, const uint16_t length, const uint16_t watermark);
+DAC7678_State DAC7678_stream_set_mode(DAC7678_Stream *stream, const DAC7678_StreamMode mode);
+DAC7678_State DAC7678_stream_start(DAC7678_Stream *stream, const DAC7678_ChannelMsk channel_mask);
+DAC7678_State DAC7678_stream_stop(DAC7678_Stream *stream, const DAC7678_ChannelMsk channel_mask);
+// NOTE: returns the samples taken; stops at a full ring or at a sample above DAC7678_MAX_VALUE
+uint16_t DAC7678_stream_push(DAC7678_Stream *stream, const DAC7678_ChannelIdx channel_idx, const uint16_t *samples, const uint16_t count);
+uint16_t DAC7678_stream_level(const DAC7678_Stream *stream, const DAC7678_ChannelIdx channel_idx);
+
+// NOTE: call from the sample timer interrupt; while streaming the engine is the device's only queue producer
+void DAC7678_stream_tick(DAC7678_Stream *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DAC7678_STREAM_H_ */
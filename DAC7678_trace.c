@@ -0,0 +1,93 @@
+/*
+ * DAC7678_trace.c
+ */
+
+#include "DAC7678_trace.h"
+
+#ifdef DAC7678_TRACE
+
+#define DAC7678_TRACE_MASK (DAC7678_TRACE_SIZE - 1)
+
+static DAC7678_TraceEntry s_trace[DAC7678_TRACE_SIZE];
+static volatile uint32_t s_trace_head = 0; // entries ever claimed
+
+static uint32_t DAC7678_trace_claim(void)
+{
+#if defined(__ARM_ARCH_6M__)
+	// Cortex-M0 has no LDREX/STREX, mask for the one increment
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	const uint32_t seq = s_trace_head++;
+	__set_PRIMASK(primask);
+
+	return seq;
+#else
+	return __atomic_fetch_add(&s_trace_head, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+void DAC7678_trace_record(const uint8_t bus, const DAC7678_TraceEvent event, const uint8_t address, const DAC7678_State state, const uint8_t command, const uint8_t *payload, const uint8_t size)
+{
+	const uint32_t seq = DAC7678_trace_claim();
+	DAC7678_TraceEntry *entry = &s_trace[seq & DAC7678_TRACE_MASK];
+
+	// a reader skips the entry until seq is published again
+	entry->seq = 0;
+	__DMB();
+	entry->time_us = DAC7678_now_us();
+	entry->event = (uint8_t)((bus << 4) | event);
+	entry->address = address;
+	entry->state = (int8_t)state;
+	entry->size = size;
+	entry->data[0] = command;
+	for (uint8_t i = 0; i < 3; ++i) entry->data[1 + i] = (payload && (i < size)) ? payload[i] : 0;
+	__DMB();
+	entry->seq = seq + 1;
+}
+
+uint32_t DAC7678_trace_head(void)
+{
+	return s_trace_head;
+}
+
+uint16_t DAC7678_trace_read(uint32_t *cursor, DAC7678_TraceEntry *entries, const uint16_t max, uint32_t *lost)
+{
+	const uint32_t head = s_trace_head;
+	uint32_t skipped = 0;
+	uint16_t count = 0;
+
+	if (head - *cursor > DAC7678_TRACE_SIZE)
+	{
+		skipped += head - DAC7678_TRACE_SIZE - *cursor;
+		*cursor = head - DAC7678_TRACE_SIZE;
+	}
+
+	while ((count < max) && (*cursor != head))
+	{
+		const DAC7678_TraceEntry *entry = &s_trace[*cursor & DAC7678_TRACE_MASK];
+		const uint32_t seq = entry->seq;
+
+		// not published yet: a writer was interrupted between claim and publish, stop there
+		if ((int32_t)(seq - (*cursor + 1)) < 0) break;
+
+		entries[count] = *entry;
+		__DMB();
+
+		// overwritten by a later lap, before or while it was copied
+		if ((seq != *cursor + 1) || (entry->seq != seq))
+		{
+			skipped++;
+			(*cursor)++;
+			continue;
+		}
+
+		count++;
+		(*cursor)++;
+	}
+
+	if (lost) *lost += skipped;
+
+	return count;
+}
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ * DAC7678_trace.h
+ */
+
+#ifndef DAC7678_TRACE_H_
+#define DAC7678_TRACE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "DAC7678.h"
+
+#define DAC7678_TRACE_SIZE		256 // entries, power of two; the oldest are overwritten
+
+typedef enum
+{
+	DAC7678_TRACE_WRITE		= 1, // frame handed to the transport
+	DAC7678_TRACE_READ		= 2, // command byte handed to the transport, readback follows a repeated START
+	DAC7678_TRACE_DONE		= 3, // transfer finished or failed; a read that finished carries its readback
+} DAC7678_TraceEvent;
+
+// NOTE: 16 bytes, little endian; a dump is these records back to back, in any order
+typedef struct
+{
+	uint32_t	seq; // 1 + position in the trace, 0 while the entry is written
+	uint32_t	time_us; // DAC7678_now_us()
+	uint8_t		event; // DAC7678_TraceEvent, bus index in the high nibble
+	uint8_t		address; // 7-bit
+	int8_t		state; // DAC7678_State of a done event, DAC7678_NONE otherwise
+	uint8_t		size; // bytes after the command byte, written or read back
+	uint8_t		data[4]; // command byte, then the first of those bytes
+} DAC7678_TraceEntry;
+
+// NOTE: any context, the I2C interrupt included; claims the entry with one atomic increment
+void DAC7678_trace_record(const uint8_t bus, const DAC7678_TraceEvent event, const uint8_t address, const DAC7678_State state, const uint8_t command, const uint8_t *payload, const uint8_t size);
+uint32_t DAC7678_trace_head(void); // cursor of the next entry
+// NOTE: copies up to max entries from *cursor on and advances it; entries the ring overwrote are skipped and added to *lost
+uint16_t DAC7678_trace_read(uint32_t *cursor, DAC7678_TraceEntry *entries, const uint16_t max, uint32_t *lost);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DAC7678_TRACE_H_ */
@@ -0,0 +1,196 @@
+/*
+ * DAC7678_wave.c
+ */
+
+#include "DAC7678_wave.h"
+
+#define DAC7678_WAVE_ONE		(1LL << 30)
+#define DAC7678_WAVE_HALF_PI	1686629713LL // pi / 2 in Q30
+
+// sine of a 32-bit phase in Q30, integer only so table fills need no libm
+static int32_t DAC7678_wave_sin(const uint32_t phase)
+{
+	const uint32_t quadrant = phase >> 30;
+	uint32_t p = phase & 0x3FFFFFFF;
+	if (quadrant & 1) p = 0x40000000 - p;
+
+	// Taylor series to x^11 in Horner form, error below 1e-6 over the quadrant
+	const int64_t x = ((int64_t)p * DAC7678_WAVE_HALF_PI) >> 30;
+	const int64_t x2 = (x * x) >> 30;
+	int64_t t = DAC7678_WAVE_ONE - x2 / 110;
+	t = DAC7678_WAVE_ONE - ((x2 * t) >> 30) / 72;
+	t = DAC7678_WAVE_ONE - ((x2 * t) >> 30) / 42;
+	t = DAC7678_WAVE_ONE - ((x2 * t) >> 30) / 20;
+	t = DAC7678_WAVE_ONE - ((x2 * t) >> 30) / 6;
+	const int64_t y = (x * t) >> 30;
+
+	return (int32_t)((quadrant & 2) ? -y : y);
+}
+
+static uint8_t DAC7678_wave_log2(const uint16_t length)
+{
+	uint8_t bits = 0;
+	while ((1U << bits) < length) bits++;
+
+	return bits;
+}
+
+DAC7678_State DAC7678_wave_fill(uint16_t *table, const uint16_t length, const DAC7678_WaveShape shape, const uint16_t amplitude, const uint16_t offset)
+{
+	if ((length < 2) || (length & (length - 1))) return DAC7678_ERROR_INVALID_VALUE;
+	if ((uint32_t)offset + amplitude > DAC7678_MAX_VALUE) return DAC7678_ERROR_INVALID_VALUE;
+
+	const uint8_t bits = DAC7678_wave_log2(length);
+	for (uint32_t i = 0; i < length; ++i)
+	{
+		uint32_t level; // Q16, 0 .. 1
+		switch (shape)
+		{
+		case DAC7678_WAVE_SINE:
+			level = (uint32_t)(((int64_t)DAC7678_wave_sin(i << (32 - bits)) + DAC7678_WAVE_ONE) >> 15);
+			break;
+		case DAC7678_WAVE_SAW:
+			level = (i << 16) / (length - 1);
+			break;
+		case DAC7678_WAVE_TRIANGLE:
+			level = (i < length / 2) ? (i << 17) / length : ((length - i) << 17) / length;
+			break;
+		case DAC7678_WAVE_SQUARE:
+			level = (i < length / 2) ? 0x10000 : 0;
+			break;
+		default:
+			return DAC7678_ERROR_INVALID_VALUE;
+		}
+
+		table[i] = (uint16_t)(offset + ((amplitude * level + 0x8000) >> 16));
+	}
+
+	return DAC7678_OK;
+}
+
+DAC7678_State DAC7678_wave_init(DAC7678_Wave *wave, DAC7678 *device, const uint32_t sample_rate)
+{
+	if (!device->m_init || sample_rate == 0) return DAC7678_ERROR;
+
+	wave->m_device = device;
+	wave->m_sample_rate = sample_rate;
+	wave->m_running = DAC7678_CHM_NONE;
+	wave->ticks = 0;
+	wave->dropped = 0;
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		wave->m_channels[channel].m_table = NULL;
+		wave->m_channels[channel].m_phase = 0;
+		wave->m_channels[channel].m_step = 0;
+		wave->m_channels[channel].m_offset = 0;
+		wave->m_channels[channel].m_shift = 32;
+	}
+
+	// every tick loads the running channels and latches them together with its last write
+	return DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_ALL);
+}
+
+DAC7678_State DAC7678_wave_set_table(DAC7678_Wave *wave, const DAC7678_ChannelIdx channel, const uint16_t *table, const uint16_t length)
+{
+	if (channel >= DAC7678_MAX_CHANNELS) return DAC7678_ERROR_INVALID_CHANNEL;
+	if ((table == NULL) || (length < 2) || (length & (length - 1))) return DAC7678_ERROR_INVALID_VALUE;
+
+	for (uint16_t i = 0; i < length; ++i)
+	{
+		if (table[i] > DAC7678_MAX_VALUE) return DAC7678_ERROR_INVALID_VALUE;
+	}
+
+	// a running channel may swap tables, the tick must never see the new table with the old shift
+	const uint8_t shift = (uint8_t)(32 - DAC7678_wave_log2(length));
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	DAC7678_WaveChannel *wc = &wave->m_channels[channel];
+	wc->m_table = table;
+	wc->m_shift = shift;
+	__set_PRIMASK(primask);
+
+	return DAC7678_OK;
+}
+
+DAC7678_State DAC7678_wave_set_sine(DAC7678_Wave *wave, const DAC7678_ChannelIdx channel)
+{
+	return DAC7678_wave_set_table(wave, channel, DAC7678_wave_sine_lut, DAC7678_WAVE_LUT_SIZE);
+}
+
+DAC7678_State DAC7678_wave_set_frequency(DAC7678_Wave *wave, const DAC7678_ChannelIdx channel, const uint32_t frequency_mhz)
+{
+	if (channel >= DAC7678_MAX_CHANNELS) return DAC7678_ERROR_INVALID_CHANNEL;
+
+	// Nyquist: at least two ticks per period
+	const uint64_t step = ((uint64_t)frequency_mhz << 32) / ((uint64_t)wave->m_sample_rate * 1000);
+	if (step > 0x80000000ULL) return DAC7678_ERROR_INVALID_VALUE;
+
+	wave->m_channels[channel].m_step = (uint32_t)step;
+
+	return DAC7678_OK;
+}
+
+DAC7678_State DAC7678_wave_set_step(DAC7678_Wave *wave, const DAC7678_ChannelIdx channel, const uint32_t step)
+{
+	if (channel >= DAC7678_MAX_CHANNELS) return DAC7678_ERROR_INVALID_CHANNEL;
+	if (step > 0x80000000UL) return DAC7678_ERROR_INVALID_VALUE;
+
+	wave->m_channels[channel].m_step = step;
+
+	return DAC7678_OK;
+}
+
+DAC7678_State DAC7678_wave_set_phase(DAC7678_Wave *wave, const DAC7678_ChannelIdx channel, const uint32_t phase_offset)
+{
+	if (channel >= DAC7678_MAX_CHANNELS) return DAC7678_ERROR_INVALID_CHANNEL;
+
+	wave->m_channels[channel].m_offset = phase_offset;
+
+	return DAC7678_OK;
+}
+
+DAC7678_State DAC7678_wave_start(DAC7678_Wave *wave, const DAC7678_ChannelMsk channel_mask)
+{
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if ((channel_mask & (1 << channel)) && (wave->m_channels[channel].m_table == NULL)) return DAC7678_ERROR_INVALID_CHANNEL;
+	}
+
+	wave->m_running |= (uint8_t)channel_mask;
+
+	return DAC7678_OK;
+}
+
+DAC7678_State DAC7678_wave_stop(DAC7678_Wave *wave, const DAC7678_ChannelMsk channel_mask)
+{
+	wave->m_running &= (uint8_t)~channel_mask;
+
+	return DAC7678_OK;
+}
+
+uint8_t DAC7678_wave_render(DAC7678_Wave *wave)
+{
+	const uint8_t running = wave->m_running;
+	DAC7678 *device = wave->m_device;
+
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (!(running & (1 << channel))) continue;
+
+		DAC7678_WaveChannel *wc = &wave->m_channels[channel];
+		device->values[channel] = wc->m_table[(uint32_t)(wc->m_phase + wc->m_offset) >> wc->m_shift];
+		wc->m_phase += wc->m_step;
+	}
+
+	return running;
+}
+
+void DAC7678_wave_tick(DAC7678_Wave *wave)
+{
+	const uint8_t running = DAC7678_wave_render(wave);
+	if (running == DAC7678_CHM_NONE) return;
+
+	// phases keep advancing on a drop so the waveform stays on time
+	wave->ticks++;
+	if (DAC7678_set_channels_async(wave->m_device, (DAC7678_ChannelMsk)running, NULL, NULL) != DAC7678_OK) wave->dropped++;
+}
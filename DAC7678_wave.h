@@ -0,0 +1,71 @@
+/*
+ * DAC7678_wave.h
+ */
+
+#ifndef DAC7678_WAVE_H_
+#define DAC7678_WAVE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "DAC7678.h"
+
+#define DAC7678_WAVE_LUT_BITS	10 // built-in sine table, 8 (256 entries) or 10 (1024 entries)
+#define DAC7678_WAVE_LUT_SIZE	(1 << DAC7678_WAVE_LUT_BITS)
+
+// phase in degrees as a 32-bit phase word, for constants
+#define DAC7678_WAVE_DEGREES(deg) ((uint32_t)((deg) * 11930464.711111111))
+
+typedef enum
+{
+	DAC7678_WAVE_NONE		= -1,
+	DAC7678_WAVE_SINE		= 0,
+	DAC7678_WAVE_SAW		= 1,
+	DAC7678_WAVE_TRIANGLE	= 2,
+	DAC7678_WAVE_SQUARE		= 3,
+} DAC7678_WaveShape;
+
+typedef struct
+{
+	const uint16_t	*m_table;
+	uint32_t		m_phase; // 2^32 = one period
+	uint32_t		m_step; // phase increment per tick, the DDS tuning word
+	uint32_t		m_offset; // phase offset added at lookup
+	uint8_t			m_shift; // 32 - log2(table length)
+} DAC7678_WaveChannel;
+
+typedef struct
+{
+	DAC7678				*m_device;
+	DAC7678_WaveChannel	m_channels[DAC7678_MAX_CHANNELS];
+	uint32_t			m_sample_rate; // Hz, rate DAC7678_wave_tick is called at
+	volatile uint8_t	m_running; // DAC7678_ChannelMsk
+	uint32_t			ticks;
+	uint32_t			dropped; // ticks lost to a full transfer queue
+} DAC7678_Wave;
+
+// NOTE: table length is a power of two, samples span offset .. offset + amplitude
+DAC7678_State DAC7678_wave_fill(uint16_t *table, const uint16_t length, const DAC7678_WaveShape shape, const uint16_t amplitude, const uint16_t offset);
+
+DAC7678_State DAC7678_wave_init(DAC7678_Wave *wave, DAC7678 *device, const uint32_t sample_rate);
+DAC7678_State DAC7678_wave_set_table(DAC7678_Wave *wave, const DAC7678_ChannelIdx channel_idx, const uint16_t *table, const uint16_t length);
+DAC7678_State DAC7678_wave_set_sine(DAC7678_Wave *wave, const DAC7678_ChannelIdx channel_idx); // built-in full scale table
+DAC7678_State DAC7678_wave_set_frequency(DAC7678_Wave *wave, const DAC7678_ChannelIdx channel_idx, const uint32_t frequency_mhz);
+DAC7678_State DAC7678_wave_set_step(DAC7678_Wave *wave, const DAC7678_ChannelIdx channel_idx, const uint32_t step); // sample_rate / 2^32 Hz resolution
+DAC7678_State DAC7678_wave_set_phase(DAC7678_Wave *wave, const DAC7678_ChannelIdx channel_idx, const uint32_t phase_offset);
+DAC7678_State DAC7678_wave_start(DAC7678_Wave *wave, const DAC7678_ChannelMsk channel_mask);
+DAC7678_State DAC7678_wave_stop(DAC7678_Wave *wave, const DAC7678_ChannelMsk channel_mask);
+
+// NOTE: call from the sample timer interrupt; while running the engine is the device's only queue producer
+void DAC7678_wave_tick(DAC7678_Wave *wave);
+// NOTE: next sample of every running channel into device->values[], no bus traffic
+uint8_t DAC7678_wave_render(DAC7678_Wave *wave);
+
+extern const uint16_t DAC7678_wave_sine_lut[DAC7678_WAVE_LUT_SIZE];
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DAC7678_WAVE_H_ */
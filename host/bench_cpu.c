@@ -0,0 +1,158 @@
+/*
+ * bench_cpu.c
+ *
+ *  CPU cost of the per-sample paths that run without bus traffic: DDS sample
+ *  generation against a libm sinf() baseline, and fixed-point calibration
+ *  against the float correction it replaces. Cycles come from the TSC on x86
+ *  hosts, other hosts report nanoseconds only.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "DAC7678.h"
+#include "DAC7678_wave.h"
+#include "sim_dac7678.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES() __rdtsc()
+#else
+#define BENCH_CYCLES() 0ULL
+#endif
+
+#define DAC_ADDRESS		0x48
+#define BENCH_SAMPLES	200000UL
+
+static SIM_I2C_Bus s_bus;
+static SIM_DAC7678 s_model;
+static DAC7678 s_dac;
+static DAC7678_Wave s_wave;
+
+static volatile uint16_t s_sink;
+
+static uint64_t bench_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void bench_report(const char *name, const uint8_t channels, const uint64_t cycles, const uint64_t ns)
+{
+	const double samples = (double)BENCH_SAMPLES * channels;
+	printf("%-24s %8u %14.2f %14.2f\r\n", name, channels, (double)cycles / samples, (double)ns / samples);
+}
+
+static void bench_header(const char *title)
+{
+	printf("\r\n%s, %lu iterations\r\n", title, (unsigned long)BENCH_SAMPLES);
+	printf("%-24s %8s %14s %14s\r\n", "path", "channels", "cycles/sample", "ns/sample");
+}
+
+static void bench_render(const uint8_t channels)
+{
+	DAC7678_wave_stop(&s_wave, DAC7678_CHM_ALL);
+	DAC7678_wave_start(&s_wave, (uint8_t)((1U << channels) - 1));
+
+	const uint64_t ns = bench_ns();
+	const uint64_t cycles = BENCH_CYCLES();
+	for (uint32_t i = 0; i < BENCH_SAMPLES; ++i)
+	{
+		DAC7678_wave_render(&s_wave);
+		s_sink = s_dac.values[0];
+	}
+	bench_report("wave_render (LUT)", channels, BENCH_CYCLES() - cycles, bench_ns() - ns);
+}
+
+static void bench_sinf(const uint8_t channels)
+{
+	float phase[DAC7678_MAX_CHANNELS];
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		phase[channel] = (float)channel * 0.785398163f;
+	}
+
+	const float step = 6.283185307f * 1000.0f / 48000.0f;
+	const uint64_t ns = bench_ns();
+	const uint64_t cycles = BENCH_CYCLES();
+	for (uint32_t i = 0; i < BENCH_SAMPLES; ++i)
+	{
+		for (uint8_t channel = 0; channel < channels; ++channel)
+		{
+			s_dac.values[channel] = (uint16_t)(2047.5f + 2047.5f * sinf(phase[channel]));
+			phase[channel] += step;
+			if (phase[channel] > 6.283185307f) phase[channel] -= 6.283185307f;
+		}
+		s_sink = s_dac.values[0];
+	}
+	bench_report("sinf (libm)", channels, BENCH_CYCLES() - cycles, bench_ns() - ns);
+}
+
+static void bench_calibrate(const char *name)
+{
+	const uint64_t ns = bench_ns();
+	const uint64_t cycles = BENCH_CYCLES();
+	for (uint32_t i = 0; i < BENCH_SAMPLES; ++i)
+	{
+		s_sink = DAC7678_calibrate(&s_dac, DAC7678_CH_A, (uint16_t)(i & DAC7678_MAX_VALUE));
+	}
+	bench_report(name, 1, BENCH_CYCLES() - cycles, bench_ns() - ns);
+}
+
+static void bench_calibrate_float(void)
+{
+	volatile float gain = 1.0123f;
+	volatile float offset = -2.5f;
+	const float g = gain;
+	const float o = offset;
+
+	const uint64_t ns = bench_ns();
+	const uint64_t cycles = BENCH_CYCLES();
+	for (uint32_t i = 0; i < BENCH_SAMPLES; ++i)
+	{
+		float code = (float)(i & DAC7678_MAX_VALUE) * g + o;
+		if (code < 0.0f) code = 0.0f;
+		if (code > (float)DAC7678_MAX_VALUE) code = (float)DAC7678_MAX_VALUE;
+		s_sink = (uint16_t)lroundf(code);
+	}
+	bench_report("gain/offset (float)", 1, BENCH_CYCLES() - cycles, bench_ns() - ns);
+}
+
+int main(void)
+{
+	static const int16_t inl[17] = { 0, 6, 11, 15, 18, 20, 21, 21, 20, 18, 15, 12, 9, 6, 3, 1, 0 };
+
+	SIM_I2C_init(&s_bus, &SIM_I2C_FAST);
+	SIM_DAC7678_init(&s_model, DAC_ADDRESS);
+	SIM_I2C_attach(&s_bus, &s_model.device);
+	DAC7678_init(&s_dac, &s_bus.hi2c, DAC_ADDRESS);
+
+	// 1 kHz at 48 kHz, eight phases 45 degrees apart
+	DAC7678_wave_init(&s_wave, &s_dac, 48000);
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		DAC7678_wave_set_sine(&s_wave, channel);
+		DAC7678_wave_set_frequency(&s_wave, channel, 1000000);
+		DAC7678_wave_set_phase(&s_wave, channel, channel * DAC7678_WAVE_DEGREES(45));
+	}
+
+	bench_header("DDS sample generation");
+	const uint8_t channels[] = { 1, 8 };
+	for (uint8_t i = 0; i < sizeof(channels); ++i)
+	{
+		bench_render(channels[i]);
+		bench_sinf(channels[i]);
+	}
+
+	bench_header("Calibration, one channel write");
+	bench_calibrate("calibrate (off)");
+	DAC7678_set_calibration(&s_dac, DAC7678_CH_A, DAC7678_CAL_Q16(1.0123), DAC7678_CAL_Q16(-2.5));
+	bench_calibrate("calibrate (gain/offset)");
+	DAC7678_set_inl(&s_dac, DAC7678_CH_A, inl, 4);
+	bench_calibrate("calibrate (+ INL)");
+	bench_calibrate_float();
+
+	return 0;
+}
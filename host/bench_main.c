@@ -0,0 +1,322 @@
+/*
+ * bench_main.c
+ *
+ *  Bus cost of every public DAC7678 call on the simulated bus, per timing
+ *  model. Each call starts on an idle bus and is measured until the bus is
+ *  idle again, so IT transfers left in flight are included in bus time.
+ */
+
+#include <stdio.h>
+
+#include "DAC7678.h"
+#include "sim_dac7678.h"
+#include "sim_transport.h"
+
+#define DAC_ADDRESS 0x48
+
+#if defined(DAC7678_DMA)
+#define BENCH_TRANSPORT "DMA"
+#elif defined(DAC7678_INTERRUPTS)
+#define BENCH_TRANSPORT "IT"
+#else
+#define BENCH_TRANSPORT "blocking"
+#endif
+
+typedef struct
+{
+	const char		*name;
+	DAC7678_State	(*call)(DAC7678 *device);
+	void			(*prepare)(DAC7678 *device); // optional, runs before the measurement
+} Bench_Call;
+
+static SIM_I2C_Bus s_bus;
+static SIM_DAC7678 s_model;
+static DAC7678 s_dac;
+
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	DAC7678_i2c_tx_cplt(hi2c);
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	DAC7678_i2c_rx_cplt(hi2c);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+	DAC7678_i2c_error(hi2c);
+}
+
+void HAL_I2C_AbortCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	DAC7678_i2c_abort_cplt(hi2c);
+}
+
+static DAC7678_State bench_set_value(DAC7678 *device)
+{
+	return DAC7678_set_value(device, DAC7678_CH_D, 2048);
+}
+
+static DAC7678_State bench_set_values(DAC7678 *device)
+{
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		device->values[channel] = (uint16_t)(channel * 500);
+	}
+	return DAC7678_set_values(device);
+}
+
+static DAC7678_State bench_set_values_async(DAC7678 *device)
+{
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		device->values[channel] = (uint16_t)(channel * 500);
+	}
+	return DAC7678_set_values_async(device, NULL, NULL);
+}
+
+static DAC7678_State bench_set_values_equal(DAC7678 *device)
+{
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		device->values[channel] = 1000;
+	}
+	return DAC7678_set_values(device);
+}
+
+static void bench_prepare_dirty(DAC7678 *device)
+{
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		device->values[channel] = (uint16_t)(channel * 500);
+	}
+	DAC7678_set_values_dirty(device, DAC7678_WRT_UPDATE_ALL);
+}
+
+static DAC7678_State bench_set_values_dirty(DAC7678 *device)
+{
+	// one channel moved since the last tick
+	device->values[3] = (uint16_t)(device->values[3] ^ 1);
+	return DAC7678_set_values_dirty(device, DAC7678_WRT_UPDATE_ALL);
+}
+
+static DAC7678_State bench_set_value_loop(DAC7678 *device)
+{
+	for (uint8_t i = 0; i < DAC7678_MAX_BURST; ++i)
+	{
+		DAC7678_State state = DAC7678_set_value(device, DAC7678_CH_D, (uint16_t)(i * 500));
+		if (state != DAC7678_OK) return state;
+	}
+	return DAC7678_OK;
+}
+
+static DAC7678_State bench_set_value_burst(DAC7678 *device)
+{
+	uint16_t values[DAC7678_MAX_BURST];
+	for (uint8_t i = 0; i < DAC7678_MAX_BURST; ++i)
+	{
+		values[i] = (uint16_t)(i * 500);
+	}
+	return DAC7678_set_value_burst(device, DAC7678_CH_D, values, DAC7678_MAX_BURST);
+}
+
+static DAC7678_State bench_update_dac_reg(DAC7678 *device)
+{
+	return DAC7678_update_dac_reg(device, DAC7678_CH_D);
+}
+
+static DAC7678_State bench_set_power_reg(DAC7678 *device)
+{
+	return DAC7678_set_power_reg(device, DAC7678_PWR_ON, DAC7678_CHM_ALL);
+}
+
+static DAC7678_State bench_set_clear_reg(DAC7678 *device)
+{
+	return DAC7678_set_clear_reg(device, DAC7678_CLR_MID);
+}
+
+static DAC7678_State bench_set_ldac_reg(DAC7678 *device)
+{
+	return DAC7678_set_ldac_reg(device, DAC7678_CHM_NONE);
+}
+
+static DAC7678_State bench_set_int_ref_static_reg(DAC7678 *device)
+{
+	return DAC7678_set_int_ref_static_reg(device, DAC7678_REF_S_ON);
+}
+
+static DAC7678_State bench_set_int_ref_flexi_reg(DAC7678 *device)
+{
+	return DAC7678_set_int_ref_flexi_reg(device, DAC7678_REF_F_AS_STATIC);
+}
+
+static DAC7678_State bench_reset(DAC7678 *device)
+{
+	return DAC7678_reset(device, DAC7678_RST);
+}
+
+static DAC7678_State bench_get_value(DAC7678 *device)
+{
+	uint16_t value;
+	return DAC7678_get_value(device, DAC7678_CH_D, &value);
+}
+
+static DAC7678_State bench_get_value_async(DAC7678 *device)
+{
+	static uint16_t value;
+	return DAC7678_get_value_async(device, DAC7678_CH_D, &value, NULL, NULL);
+}
+
+static DAC7678_State bench_get_dac_reg(DAC7678 *device)
+{
+	uint16_t value;
+	return DAC7678_get_dac_reg(device, DAC7678_CH_D, &value);
+}
+
+static DAC7678_State bench_get_power_reg(DAC7678 *device)
+{
+	DAC7678_PowerOptions options;
+	DAC7678_ChannelMsk channel_mask;
+	return DAC7678_get_power_reg(device, &options, &channel_mask);
+}
+
+static DAC7678_State bench_get_clear_reg(DAC7678 *device)
+{
+	DAC7678_ClearOptions options;
+	return DAC7678_get_clear_reg(device, &options);
+}
+
+static void bench_prepare_cache(DAC7678 *device)
+{
+	DAC7678_set_cache_policy(device, DAC7678_CACHE_READ_THROUGH, 0);
+	DAC7678_set_clear_reg(device, DAC7678_CLR_MID);
+}
+
+static DAC7678_State bench_get_clear_reg_cached(DAC7678 *device)
+{
+	DAC7678_ClearOptions options;
+	const DAC7678_State state = DAC7678_get_clear_reg(device, &options);
+	DAC7678_set_cache_policy(device, DAC7678_CACHE_OFF, 0);
+	return state;
+}
+
+static DAC7678_State bench_get_ldac_reg(DAC7678 *device)
+{
+	DAC7678_ChannelMsk channel_mask;
+	return DAC7678_get_ldac_reg(device, &channel_mask);
+}
+
+static DAC7678_State bench_get_int_ref_static_reg(DAC7678 *device)
+{
+	DAC7678_ReferenceStaticOptions options;
+	return DAC7678_get_int_ref_static_reg(device, &options);
+}
+
+static DAC7678_State bench_get_int_ref_flexi_reg(DAC7678 *device)
+{
+	DAC7678_ReferenceFlexiOptions options;
+	return DAC7678_get_int_ref_flexi_reg(device, &options);
+}
+
+static const Bench_Call s_calls[] =
+{
+	{ "set_value",				bench_set_value, NULL },
+	{ "set_values",				bench_set_values, NULL },
+	{ "set_values_async",		bench_set_values_async, NULL },
+	{ "set_values (equal)",		bench_set_values_equal, NULL },
+	{ "set_values_dirty 1/8",	bench_set_values_dirty, bench_prepare_dirty },
+	{ "set_value x8",			bench_set_value_loop, NULL },
+	{ "set_value_burst x8",		bench_set_value_burst, NULL },
+	{ "update_dac_reg",			bench_update_dac_reg, NULL },
+	{ "set_power_reg",			bench_set_power_reg, NULL },
+	{ "set_clear_reg",			bench_set_clear_reg, NULL },
+	{ "set_ldac_reg",			bench_set_ldac_reg, NULL },
+	{ "set_int_ref_static_reg",	bench_set_int_ref_static_reg, NULL },
+	{ "set_int_ref_flexi_reg",	bench_set_int_ref_flexi_reg, NULL },
+	{ "reset",					bench_reset, NULL },
+	{ "get_value",				bench_get_value, NULL },
+	{ "get_value_async",		bench_get_value_async, NULL },
+	{ "get_dac_reg",			bench_get_dac_reg, NULL },
+	{ "get_power_reg",			bench_get_power_reg, NULL },
+	{ "get_clear_reg",			bench_get_clear_reg, NULL },
+	{ "get_clear_reg (cached)",	bench_get_clear_reg_cached, bench_prepare_cache },
+	{ "get_ldac_reg",			bench_get_ldac_reg, NULL },
+	{ "get_int_ref_static_reg",	bench_get_int_ref_static_reg, NULL },
+	{ "get_int_ref_flexi_reg",	bench_get_int_ref_flexi_reg, NULL },
+};
+
+static void bench_header(const SIM_I2C_Timing *timing)
+{
+	printf("\r\n%s, %s transport, %lu MHz core\r\n", timing->name, BENCH_TRANSPORT, (unsigned long)(SIM_I2C_CPU_HZ / 1000000));
+	printf("%-24s %5s %6s %6s %10s %10s %12s %5s\r\n",
+			"call", "trans", "starts", "bytes", "bus us", "call us", "spin cycles", "irqs");
+}
+
+static void bench_run(const Bench_Call *bench)
+{
+	if (bench->prepare) bench->prepare(&s_dac);
+	SIM_I2C_wait_idle();
+	SIM_I2C_reset_stats(&s_bus);
+
+	const uint64_t start = SIM_I2C_now_ns();
+	const DAC7678_State state = bench->call(&s_dac);
+	const uint64_t call_ns = SIM_I2C_now_ns() - start;
+	const uint64_t spin_ns = s_bus.stats.spin_ns;
+	SIM_I2C_wait_idle();
+
+	printf("%-24s %5lu %6lu %6lu %10.2f %10.2f %12llu %5lu%s\r\n",
+			bench->name,
+			(unsigned long)s_bus.stats.transactions,
+			(unsigned long)s_bus.stats.starts,
+			(unsigned long)s_bus.stats.bytes,
+			(double)s_bus.stats.bus_ns / 1000.0,
+			(double)call_ns / 1000.0,
+			(unsigned long long)SIM_I2C_ns_to_cycles(spin_ns),
+			(unsigned long)s_bus.stats.interrupts,
+			state == DAC7678_OK ? "" : "  (error)");
+}
+
+static DAC7678_State bench_hs_enter(DAC7678 *device)
+{
+	return DAC7678_bus_hs_enter(device->m_bus, SIM_clock_hook);
+}
+
+static void bench_setup(const SIM_I2C_Timing *timing)
+{
+	SIM_I2C_init(&s_bus, timing);
+	SIM_DAC7678_init(&s_model, DAC_ADDRESS);
+	SIM_I2C_attach(&s_bus, &s_model.device);
+	DAC7678_init(&s_dac, &s_bus.hi2c, DAC_ADDRESS);
+}
+
+int main(void)
+{
+	const SIM_I2C_Timing *timings[] = { &SIM_I2C_STANDARD, &SIM_I2C_FAST, &SIM_I2C_HIGH_SPEED };
+
+	for (uint8_t t = 0; t < sizeof(timings) / sizeof(timings[0]); ++t)
+	{
+		bench_setup(timings[t]);
+		DAC7678_set_write_options(&s_dac, DAC7678_WRT_UPDATE_ON);
+
+		bench_header(timings[t]);
+		for (uint8_t i = 0; i < sizeof(s_calls) / sizeof(s_calls[0]); ++i)
+		{
+			bench_run(&s_calls[i]);
+		}
+	}
+
+	// Hs-mode session: one master code on entry, then the chip stays in Hs-mode across STOPs
+	bench_setup(&SIM_I2C_FAST);
+	bench_header(&SIM_I2C_HIGH_SPEED_HELD);
+	const Bench_Call enter = { "bus_hs_enter", bench_hs_enter, NULL };
+	bench_run(&enter);
+	DAC7678_set_write_options(&s_dac, DAC7678_WRT_UPDATE_ON);
+	for (uint8_t i = 0; i < sizeof(s_calls) / sizeof(s_calls[0]); ++i)
+	{
+		bench_run(&s_calls[i]);
+	}
+	DAC7678_bus_hs_exit(s_dac.m_bus);
+
+	return 0;
+}
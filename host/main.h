@@ -0,0 +1,102 @@
+/*
+ * main.h
+ *
+ *  Host stand-in for the CubeMX generated main.h. Provides the subset of the
+ *  STM32 HAL used by DAC7678.c, backed by the simulated bus in sim_i2c.c.
+ */
+
+#ifndef MAIN_H_
+#define MAIN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef __IO
+#define __IO volatile
+#endif
+
+#define HAL_MAX_DELAY 0xFFFFFFFFU
+
+#define HAL_I2C_ERROR_NONE		0x00000000U
+#define HAL_I2C_ERROR_BERR		0x00000001U
+#define HAL_I2C_ERROR_ARLO		0x00000002U
+#define HAL_I2C_ERROR_AF		0x00000004U
+#define HAL_I2C_ERROR_OVR		0x00000008U
+#define HAL_I2C_ERROR_DMA		0x00000010U
+#define HAL_I2C_ERROR_TIMEOUT	0x00000020U
+
+#define I2C_MEMADD_SIZE_8BIT	0x00000001U
+#define I2C_MEMADD_SIZE_16BIT	0x00000010U
+
+typedef enum
+{
+	HAL_OK		= 0x00U,
+	HAL_ERROR	= 0x01U,
+	HAL_BUSY	= 0x02U,
+	HAL_TIMEOUT	= 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum
+{
+	HAL_I2C_STATE_RESET		= 0x00U,
+	HAL_I2C_STATE_READY		= 0x20U,
+	HAL_I2C_STATE_BUSY		= 0x24U,
+	HAL_I2C_STATE_BUSY_TX	= 0x21U,
+	HAL_I2C_STATE_BUSY_RX	= 0x22U,
+	HAL_I2C_STATE_ABORT		= 0x60U,
+	HAL_I2C_STATE_ERROR		= 0xE0U
+} HAL_I2C_StateTypeDef;
+
+typedef struct __I2C_HandleTypeDef
+{
+	void						*Instance;	// points at the owning SIM_I2C_Bus
+	uint8_t						*pBuffPtr;
+	uint16_t					XferSize;
+	__IO uint16_t				XferCount;
+	__IO uint32_t				XferOptions;
+	__IO HAL_I2C_StateTypeDef	State;
+	__IO uint32_t				ErrorCode;
+	__IO uint32_t				Devaddress;
+} I2C_HandleTypeDef;
+
+// CMSIS core, single threaded on the host
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t priMask) { (void)priMask; }
+static inline void __disable_irq(void) { }
+static inline void __enable_irq(void) { }
+static inline void __DMB(void) { __sync_synchronize(); }
+
+uint32_t HAL_GetTick(void);
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Master_Receive_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Master_Receive_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+
+HAL_StatusTypeDef HAL_I2C_Master_Abort_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress);
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c);
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef *hi2c);
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef *hi2c);
+
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_AbortCpltCallback(I2C_HandleTypeDef *hi2c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MAIN_H_ */
@@ -0,0 +1,172 @@
+/*
+ * sim_dac7678.c
+ */
+
+#include "sim_dac7678.h"
+
+static void sim_dac_update(SIM_DAC7678 *dac, const uint8_t access)
+{
+	for (uint8_t channel = 0; channel < 8; ++channel)
+	{
+		if (access == 0x0F || access == channel) dac->dac[channel] = dac->input[channel];
+	}
+}
+
+static void sim_dac_load(SIM_DAC7678 *dac, const uint8_t access, const uint16_t value)
+{
+	for (uint8_t channel = 0; channel < 8; ++channel)
+	{
+		if (access == 0x0F || access == channel) dac->input[channel] = value;
+	}
+}
+
+static void sim_dac_execute(SIM_DAC7678 *dac, const uint8_t command, const uint8_t msdb, const uint8_t lsdb)
+{
+	const uint8_t access = command & 0x0F;
+	const uint16_t value = (uint16_t)((msdb << 4) | (lsdb >> 4));
+
+	if ((command & 0xF0) <= 0x30)
+	{
+		if (access > 0x07 && access != 0x0F) return; // invalid code, no action
+	}
+
+	switch (command & 0xF0)
+	{
+	case 0x00:
+		sim_dac_load(dac, access, value);
+		break;
+	case 0x10:
+		sim_dac_update(dac, access);
+		break;
+	case 0x20:
+		sim_dac_load(dac, access, value);
+		sim_dac_update(dac, 0x0F);
+		break;
+	case 0x30:
+		sim_dac_load(dac, access, value);
+		sim_dac_update(dac, access);
+		break;
+	case 0x40:
+		dac->power_mode = (msdb >> 5) & 0x03;
+		dac->power_mask = (uint8_t)(((msdb & 0x1F) << 3) | (lsdb >> 5));
+		break;
+	case 0x50:
+		dac->clear_code = (lsdb >> 4) & 0x03;
+		break;
+	case 0x60:
+		dac->ldac_mask = msdb;
+		break;
+	case 0x70:
+	{
+		const uint8_t hs = (msdb >> 6) & 0x03;
+		const uint8_t keep = dac->device.hs_mode;
+		SIM_DAC7678_reset(dac);
+		if (hs == 0x01) dac->device.hs_mode = 1;
+		else if (hs == 0x02) dac->device.hs_mode = keep;
+		break;
+	}
+	case 0x80:
+		dac->ref_static = (lsdb >> 4) & 0x01;
+		break;
+	case 0x90:
+		dac->ref_flexi = (msdb >> 4) & 0x07;
+		break;
+	default:
+		return;
+	}
+
+	dac->writes++;
+}
+
+static void sim_dac_write(SIM_I2C_Device *device, const uint8_t *data, uint16_t size)
+{
+	SIM_DAC7678 *dac = (SIM_DAC7678 *)device;
+	if (size == 0) return;
+
+	dac->pointer = data[0];
+
+	// repeated MSDB/LSDB pairs go to the register addressed by the first byte
+	for (uint16_t i = 1; i + 1 < size; i += 2)
+	{
+		sim_dac_execute(dac, data[0], data[i], data[i + 1]);
+	}
+}
+
+static void sim_dac_read(SIM_I2C_Device *device, uint8_t *data, uint16_t size)
+{
+	SIM_DAC7678 *dac = (SIM_DAC7678 *)device;
+	const uint8_t access = dac->pointer & 0x0F;
+	uint8_t msdb = 0x00;
+	uint8_t lsdb = 0x00;
+
+	switch (dac->pointer & 0xF0)
+	{
+	case 0x00:
+		if (access < 8)
+		{
+			msdb = (uint8_t)(dac->input[access] >> 4);
+			lsdb = (uint8_t)(dac->input[access] << 4);
+		}
+		break;
+	case 0x10:
+		if (access < 8)
+		{
+			msdb = (uint8_t)(dac->dac[access] >> 4);
+			lsdb = (uint8_t)(dac->dac[access] << 4);
+		}
+		break;
+	case 0x40:
+		msdb = dac->power_mode;
+		lsdb = dac->power_mask;
+		break;
+	case 0x50:
+		lsdb = dac->clear_code;
+		break;
+	case 0x60:
+		lsdb = dac->ldac_mask;
+		break;
+	case 0x80:
+		lsdb = dac->ref_static;
+		break;
+	case 0x90:
+		lsdb = dac->ref_flexi;
+		break;
+	default:
+		break;
+	}
+
+	for (uint16_t i = 0; i < size; ++i)
+	{
+		data[i] = (i & 1) ? lsdb : msdb;
+	}
+	dac->reads++;
+}
+
+void SIM_DAC7678_init(SIM_DAC7678 *dac, const uint8_t address)
+{
+	dac->device.address = address;
+	dac->device.broadcast = SIM_DAC7678_BROADCAST;
+	dac->device.write = sim_dac_write;
+	dac->device.read = sim_dac_read;
+	dac->device.hs_mode = 0;
+	SIM_DAC7678_reset(dac);
+	dac->writes = 0;
+	dac->reads = 0;
+}
+
+void SIM_DAC7678_reset(SIM_DAC7678 *dac)
+{
+	for (uint8_t channel = 0; channel < 8; ++channel)
+	{
+		dac->input[channel] = 0;
+		dac->dac[channel] = 0;
+	}
+	dac->power_mode = 0;
+	dac->power_mask = 0;
+	dac->clear_code = 0;
+	dac->ldac_mask = 0;
+	dac->ref_static = 0;
+	dac->ref_flexi = 0;
+	dac->device.hs_mode = 0;
+	dac->pointer = 0;
+}
@@ -0,0 +1,42 @@
+/*
+ * sim_dac7678.h
+ *
+ *  Register model of the DAC7678 (doc/dac7678.pdf, tables 17 and 18) that
+ *  plugs into the simulated I2C bus.
+ */
+
+#ifndef SIM_DAC7678_H_
+#define SIM_DAC7678_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "sim_i2c.h"
+
+#define SIM_DAC7678_BROADCAST	0x47
+
+typedef struct
+{
+	SIM_I2C_Device	device;
+	uint16_t		input[8];		// input registers A..H
+	uint16_t		dac[8];			// DAC registers A..H
+	uint8_t			power_mode;		// PD1:PD0
+	uint8_t			power_mask;		// DACH..DACA
+	uint8_t			clear_code;		// CL1:CL0
+	uint8_t			ldac_mask;		// DACH..DACA
+	uint8_t			ref_static;		// AR
+	uint8_t			ref_flexi;		// TR2:TR0
+	uint8_t			pointer;		// command and access byte of the last register addressed
+	uint32_t		writes;			// register writes decoded
+	uint32_t		reads;			// register reads served
+} SIM_DAC7678;
+
+void SIM_DAC7678_init(SIM_DAC7678 *dac, const uint8_t address);
+void SIM_DAC7678_reset(SIM_DAC7678 *dac);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_DAC7678_H_ */
@@ -0,0 +1,552 @@
+/*
+ * sim_i2c.c
+ */
+
+#include "sim_i2c.h"
+
+const SIM_I2C_Timing SIM_I2C_STANDARD	= { "100 kHz", 100000, 0, 4700 };
+const SIM_I2C_Timing SIM_I2C_FAST		= { "400 kHz", 400000, 0, 1300 };
+const SIM_I2C_Timing SIM_I2C_HIGH_SPEED	= { "3.4 MHz", 3400000, 400000, 1300 };
+const SIM_I2C_Timing SIM_I2C_HIGH_SPEED_HELD	= { "3.4 MHz held", 3400000, 0, 1300 };
+
+static SIM_I2C_Bus *s_buses[SIM_I2C_MAX_BUSES];
+static uint8_t s_num_buses = 0;
+static uint64_t s_now_ns = 0;
+static uint32_t s_micros_offset = 0;
+static uint32_t s_cpu_hz = SIM_I2C_CPU_HZ;
+
+static uint64_t sim_bits_ns(const uint32_t bits, const uint32_t hz)
+{
+	return ((uint64_t)bits * 1000000000ULL + hz / 2) / hz;
+}
+
+// START, address + payload bytes with ACK, repeated STARTs, STOP, then bus free time
+static uint64_t sim_transaction_ns(const SIM_I2C_Timing *timing, const uint16_t bytes, const uint8_t restarts)
+{
+	uint64_t ns = sim_bits_ns(1 + restarts + 9 * (uint32_t)bytes + 1, timing->scl_hz) + timing->t_buf_ns;
+	if (timing->fs_hz)
+	{
+		ns += sim_bits_ns(1 + 9, timing->fs_hz); // START + master code, NACKed
+	}
+
+	return ns;
+}
+
+// size counts every byte after the first address byte; a failed transaction ends after its address byte
+static void sim_account(SIM_I2C_Bus *bus, const uint16_t size, const uint8_t restarts, const uint32_t error, const uint64_t ns)
+{
+	bus->stats.transactions++;
+	bus->stats.starts += (bus->timing.fs_hz ? 2 : 1) + (error ? 0 : restarts);
+	bus->stats.bytes += (bus->timing.fs_hz ? 2 : 1) + (error ? 0 : size);
+	bus->stats.nacks += (error == HAL_I2C_ERROR_AF);
+	bus->stats.bus_ns += ns;
+}
+
+// the injected fault this transaction runs into, if any
+static SIM_I2C_Fault sim_take_fault(SIM_I2C_Bus *bus)
+{
+	if (bus->sda_low) return SIM_I2C_FAULT_SDA_LOW;
+	if (bus->fault_count == 0) return SIM_I2C_FAULT_NONE;
+
+	bus->fault_count--;
+	bus->stats.faults++;
+	if (bus->fault == SIM_I2C_FAULT_SDA_LOW) bus->sda_low = 1;
+
+	return bus->fault;
+}
+
+static uint32_t sim_fault_error(const SIM_I2C_Fault fault)
+{
+	switch (fault)
+	{
+	case SIM_I2C_FAULT_NACK: return HAL_I2C_ERROR_AF;
+	case SIM_I2C_FAULT_ARLO: return HAL_I2C_ERROR_ARLO;
+	case SIM_I2C_FAULT_BERR: return HAL_I2C_ERROR_BERR;
+	default: return HAL_I2C_ERROR_NONE;
+	}
+}
+
+// without a master code an Hs frame is noise to a device not held in Hs-mode
+static uint8_t sim_hears(SIM_I2C_Bus *bus, SIM_I2C_Device *device)
+{
+	return (bus->timing.scl_hz <= SIM_I2C_FS_MAX_HZ) || bus->timing.fs_hz || device->hs_mode;
+}
+
+static uint8_t sim_deliver(SIM_I2C_Bus *bus, const uint16_t address, const uint8_t rx, uint8_t *data, const uint16_t size)
+{
+	uint8_t acked = 0;
+	const uint8_t address7 = (uint8_t)(address >> 1);
+
+	for (uint8_t i = 0; i < bus->num_devices; ++i)
+	{
+		SIM_I2C_Device *device = bus->devices[i];
+		if (!sim_hears(bus, device)) continue;
+		if (device->address == address7)
+		{
+			if (rx) device->read(device, data, size);
+			else device->write(device, data, size);
+			acked = 1;
+		}
+		else if (!rx && device->broadcast && device->broadcast == address7)
+		{
+			device->write(device, data, size);
+			acked = 1;
+		}
+	}
+
+	return acked;
+}
+
+static void sim_complete(SIM_I2C_Bus *bus)
+{
+	bus->pending = 0;
+	bus->stats.interrupts += bus->pending_irqs;
+
+	if (bus->pending_abort)
+	{
+		bus->hi2c.State = HAL_I2C_STATE_READY;
+		HAL_I2C_AbortCpltCallback(&bus->hi2c);
+		return;
+	}
+
+	if (bus->pending_error)
+	{
+		bus->hi2c.ErrorCode = bus->pending_error;
+		bus->hi2c.State = HAL_I2C_STATE_READY;
+		HAL_I2C_ErrorCallback(&bus->hi2c);
+		return;
+	}
+
+	if (bus->pending_mem) sim_deliver(bus, bus->pending_address, 0, &bus->pending_mem_address, 1);
+	sim_deliver(bus, bus->pending_address, bus->pending_rx, bus->pending_data, bus->pending_size);
+
+	bus->hi2c.State = HAL_I2C_STATE_READY;
+	if (bus->pending_mem) HAL_I2C_MemRxCpltCallback(&bus->hi2c);
+	else if (bus->pending_rx) HAL_I2C_MasterRxCpltCallback(&bus->hi2c);
+	else HAL_I2C_MasterTxCpltCallback(&bus->hi2c);
+}
+
+static void sim_process(void)
+{
+	for (uint8_t i = 0; i < s_num_buses; ++i)
+	{
+		SIM_I2C_Bus *bus = s_buses[i];
+		if (bus->pending && s_now_ns >= bus->pending_done_ns) sim_complete(bus);
+	}
+}
+
+static uint8_t sim_busy(void)
+{
+	for (uint8_t i = 0; i < s_num_buses; ++i)
+	{
+		if (s_buses[i]->pending && s_buses[i]->pending_done_ns != UINT64_MAX) return 1;
+	}
+
+	return 0;
+}
+
+static uint8_t sim_has_device(SIM_I2C_Bus *bus, const uint16_t address, const uint8_t rx)
+{
+	const uint8_t address7 = (uint8_t)(address >> 1);
+
+	for (uint8_t i = 0; i < bus->num_devices; ++i)
+	{
+		if (!sim_hears(bus, bus->devices[i])) continue;
+		if (bus->devices[i]->address == address7) return 1;
+		if (!rx && bus->devices[i]->broadcast && bus->devices[i]->broadcast == address7) return 1;
+	}
+
+	return 0;
+}
+
+// a hung blocking call gives up after its HAL timeout, the peripheral is usable again but a held SDA is not
+static HAL_StatusTypeDef sim_blocking_hang(SIM_I2C_Bus *bus, const uint32_t timeout)
+{
+	const uint64_t ns = (uint64_t)timeout * 1000000ULL;
+	sim_account(bus, 0, 0, HAL_I2C_ERROR_TIMEOUT, ns);
+	bus->stats.spin_ns += ns;
+	s_now_ns += ns;
+	sim_process();
+
+	bus->hi2c.ErrorCode = HAL_I2C_ERROR_TIMEOUT;
+
+	return HAL_ERROR;
+}
+
+// injected fault first, then a missing device
+static uint32_t sim_error(SIM_I2C_Bus *bus, const SIM_I2C_Fault fault, const uint16_t address, const uint8_t rx)
+{
+	const uint32_t error = sim_fault_error(fault);
+	if (error || (fault >= SIM_I2C_FAULT_HANG)) return error;
+
+	return sim_has_device(bus, address, rx) ? HAL_I2C_ERROR_NONE : HAL_I2C_ERROR_AF;
+}
+
+static HAL_StatusTypeDef sim_blocking(I2C_HandleTypeDef *hi2c, const uint16_t address, const uint8_t rx, uint8_t *data, const uint16_t size, const uint32_t timeout)
+{
+	SIM_I2C_Bus *bus = (SIM_I2C_Bus *)hi2c->Instance;
+	if (hi2c->State != HAL_I2C_STATE_READY) return HAL_BUSY;
+
+	const SIM_I2C_Fault fault = sim_take_fault(bus);
+	if (fault >= SIM_I2C_FAULT_HANG) return sim_blocking_hang(bus, timeout);
+
+	const uint32_t error = sim_error(bus, fault, address, rx);
+	const uint64_t ns = sim_transaction_ns(&bus->timing, error ? 1 : size + 1, 0);
+	sim_account(bus, size, 0, error, ns);
+	bus->stats.spin_ns += ns;
+	s_now_ns += ns;
+	sim_process();
+
+	if (error)
+	{
+		hi2c->ErrorCode = error;
+		return HAL_ERROR;
+	}
+
+	hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+	sim_deliver(bus, address, rx, data, size);
+
+	return HAL_OK;
+}
+
+// IT takes one interrupt per byte on the wire, DMA one for the address phase and one for transfer complete
+static HAL_StatusTypeDef sim_start(I2C_HandleTypeDef *hi2c, const uint16_t address, const uint8_t rx, uint8_t *data, const uint16_t size, const uint8_t dma)
+{
+	SIM_I2C_Bus *bus = (SIM_I2C_Bus *)hi2c->Instance;
+	if (hi2c->State != HAL_I2C_STATE_READY) return HAL_BUSY;
+
+	const SIM_I2C_Fault fault = sim_take_fault(bus);
+	const uint32_t error = sim_error(bus, fault, address, rx);
+	const uint64_t ns = sim_transaction_ns(&bus->timing, error ? 1 : size + 1, 0);
+	sim_account(bus, size, 0, error, ns);
+
+	hi2c->State = rx ? HAL_I2C_STATE_BUSY_RX : HAL_I2C_STATE_BUSY_TX;
+	hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+	hi2c->pBuffPtr = data;
+	hi2c->XferSize = size;
+	hi2c->Devaddress = address;
+	bus->pending = 1;
+	bus->pending_mem = 0;
+	bus->pending_rx = rx;
+	bus->pending_error = error;
+	bus->pending_abort = 0;
+	bus->pending_irqs = (dma || error) ? 2 : size + 1;
+	bus->pending_address = address;
+	bus->pending_data = data;
+	bus->pending_size = size;
+	bus->pending_done_ns = (fault >= SIM_I2C_FAULT_HANG) ? UINT64_MAX : s_now_ns + ns;
+
+	return HAL_OK;
+}
+
+// address, memory address, repeated START, address, data: one transaction
+static uint64_t sim_mem_read_ns(SIM_I2C_Bus *bus, const uint32_t error, const uint16_t size)
+{
+	const uint64_t ns = sim_transaction_ns(&bus->timing, error ? 1 : size + 3, error ? 0 : 1);
+	sim_account(bus, size + 2, 1, error, ns);
+
+	return ns;
+}
+
+static HAL_StatusTypeDef sim_mem_read_start(I2C_HandleTypeDef *hi2c, const uint16_t address, const uint16_t mem_address, uint8_t *data, const uint16_t size, const uint8_t dma)
+{
+	SIM_I2C_Bus *bus = (SIM_I2C_Bus *)hi2c->Instance;
+	if (hi2c->State != HAL_I2C_STATE_READY) return HAL_BUSY;
+
+	const SIM_I2C_Fault fault = sim_take_fault(bus);
+	const uint32_t error = sim_error(bus, fault, address, 1);
+	const uint64_t ns = sim_mem_read_ns(bus, error, size);
+
+	hi2c->State = HAL_I2C_STATE_BUSY_RX;
+	hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+	hi2c->pBuffPtr = data;
+	hi2c->XferSize = size;
+	hi2c->Devaddress = address;
+	bus->pending = 1;
+	bus->pending_mem = 1;
+	bus->pending_mem_address = (uint8_t)mem_address;
+	bus->pending_rx = 1;
+	bus->pending_error = error;
+	bus->pending_abort = 0;
+	bus->pending_irqs = error ? 2 : dma ? 3 : size + 3; // DMA: address, memory address and transfer complete
+	bus->pending_address = address;
+	bus->pending_data = data;
+	bus->pending_size = size;
+	bus->pending_done_ns = (fault >= SIM_I2C_FAULT_HANG) ? UINT64_MAX : s_now_ns + ns;
+
+	return HAL_OK;
+}
+
+void SIM_I2C_init(SIM_I2C_Bus *bus, const SIM_I2C_Timing *timing)
+{
+	uint8_t known = 0;
+	for (uint8_t i = 0; i < s_num_buses; ++i)
+	{
+		if (s_buses[i] == bus) known = 1;
+	}
+	if (!known && s_num_buses < SIM_I2C_MAX_BUSES) s_buses[s_num_buses++] = bus;
+
+	bus->hi2c.Instance = bus;
+	bus->hi2c.State = HAL_I2C_STATE_READY;
+	bus->hi2c.ErrorCode = HAL_I2C_ERROR_NONE;
+	bus->timing = *timing;
+	bus->num_devices = 0;
+	bus->pending = 0;
+	bus->fault = SIM_I2C_FAULT_NONE;
+	bus->fault_count = 0;
+	bus->sda_low = 0;
+	SIM_I2C_reset_stats(bus);
+}
+
+void SIM_I2C_attach(SIM_I2C_Bus *bus, SIM_I2C_Device *device)
+{
+	if (bus->num_devices < SIM_I2C_MAX_DEVICES) bus->devices[bus->num_devices++] = device;
+}
+
+void SIM_I2C_set_timing(SIM_I2C_Bus *bus, const SIM_I2C_Timing *timing)
+{
+	bus->timing = *timing;
+}
+
+void SIM_I2C_reset_stats(SIM_I2C_Bus *bus)
+{
+	bus->stats = (SIM_I2C_Stats){ 0 };
+}
+
+void SIM_I2C_inject(SIM_I2C_Bus *bus, const SIM_I2C_Fault fault, const uint8_t count)
+{
+	bus->fault = fault;
+	bus->fault_count = count;
+}
+
+void SIM_I2C_bus_clear(I2C_HandleTypeDef *hi2c)
+{
+	SIM_I2C_Bus *bus = (SIM_I2C_Bus *)hi2c->Instance;
+	const uint64_t ns = sim_bits_ns(9 + 2, bus->timing.fs_hz ? bus->timing.fs_hz : bus->timing.scl_hz);
+
+	bus->stats.bus_clears++;
+	bus->stats.spin_ns += ns;
+	s_now_ns += ns;
+	bus->sda_low = 0;
+	sim_process();
+}
+
+uint64_t SIM_I2C_now_ns(void)
+{
+	return s_now_ns;
+}
+
+void SIM_I2C_advance_ns(uint64_t ns)
+{
+	const uint64_t end = s_now_ns + ns;
+
+	// step through completions in order so chained transfers start on time
+	for (;;)
+	{
+		uint64_t next = end;
+		for (uint8_t i = 0; i < s_num_buses; ++i)
+		{
+			if (s_buses[i]->pending && s_buses[i]->pending_done_ns < next) next = s_buses[i]->pending_done_ns;
+		}
+		s_now_ns = next;
+		sim_process();
+		if (next == end) break;
+	}
+}
+
+void SIM_I2C_wait_idle(void)
+{
+	while (sim_busy())
+	{
+		uint64_t next = UINT64_MAX;
+		for (uint8_t i = 0; i < s_num_buses; ++i)
+		{
+			if (s_buses[i]->pending && s_buses[i]->pending_done_ns < next) next = s_buses[i]->pending_done_ns;
+		}
+		if (next > s_now_ns) s_now_ns = next;
+		sim_process();
+	}
+}
+
+void SIM_I2C_set_cpu_hz(uint32_t hz)
+{
+	s_cpu_hz = hz;
+}
+
+uint64_t SIM_I2C_ns_to_cycles(uint64_t ns)
+{
+	return (ns * s_cpu_hz + 500000000ULL) / 1000000000ULL;
+}
+
+// a clock read in a spin loop costs a few cycles, which is how virtual time moves while the CPU waits
+static void sim_poll(void)
+{
+	const uint64_t poll_ns = (SIM_I2C_POLL_CYCLES * 1000000000ULL + s_cpu_hz / 2) / s_cpu_hz;
+
+	for (uint8_t i = 0; i < s_num_buses; ++i)
+	{
+		if (s_buses[i]->pending) s_buses[i]->stats.spin_ns += poll_ns;
+	}
+	s_now_ns += poll_ns;
+	sim_process();
+}
+
+uint32_t HAL_GetTick(void)
+{
+	sim_poll();
+
+	return (uint32_t)(s_now_ns / 1000000ULL);
+}
+
+uint32_t SIM_I2C_micros(void)
+{
+	sim_poll();
+
+	return (uint32_t)(s_now_ns / 1000ULL) + s_micros_offset;
+}
+
+void SIM_I2C_set_micros_offset(uint32_t offset)
+{
+	s_micros_offset = offset;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	return sim_blocking(hi2c, DevAddress, 0, pData, Size, Timeout);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	return sim_blocking(hi2c, DevAddress, 1, pData, Size, Timeout);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size)
+{
+	return sim_start(hi2c, DevAddress, 0, pData, Size, 0);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size)
+{
+	return sim_start(hi2c, DevAddress, 1, pData, Size, 0);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size)
+{
+	return sim_start(hi2c, DevAddress, 0, pData, Size, 1);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size)
+{
+	return sim_start(hi2c, DevAddress, 1, pData, Size, 1);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	(void)MemAddSize;
+	SIM_I2C_Bus *bus = (SIM_I2C_Bus *)hi2c->Instance;
+	if (hi2c->State != HAL_I2C_STATE_READY) return HAL_BUSY;
+
+	const SIM_I2C_Fault fault = sim_take_fault(bus);
+	if (fault >= SIM_I2C_FAULT_HANG) return sim_blocking_hang(bus, Timeout);
+
+	const uint32_t error = sim_error(bus, fault, DevAddress, 1);
+	const uint64_t ns = sim_mem_read_ns(bus, error, Size);
+	bus->stats.spin_ns += ns;
+	s_now_ns += ns;
+	sim_process();
+
+	if (error)
+	{
+		hi2c->ErrorCode = error;
+		return HAL_ERROR;
+	}
+
+	hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+	uint8_t mem = (uint8_t)MemAddress;
+	sim_deliver(bus, DevAddress, 0, &mem, 1);
+	sim_deliver(bus, DevAddress, 1, pData, Size);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	(void)MemAddSize;
+	return sim_mem_read_start(hi2c, DevAddress, MemAddress, pData, Size, 0);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress, uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+	(void)MemAddSize;
+	return sim_mem_read_start(hi2c, DevAddress, MemAddress, pData, Size, 1);
+}
+
+// a STOP ends the transfer in flight, unless a slave holds SDA low
+HAL_StatusTypeDef HAL_I2C_Master_Abort_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress)
+{
+	(void)DevAddress;
+	SIM_I2C_Bus *bus = (SIM_I2C_Bus *)hi2c->Instance;
+	if (!bus->pending || bus->pending_abort) return HAL_ERROR;
+
+	hi2c->State = HAL_I2C_STATE_ABORT;
+	bus->pending_abort = 1;
+	bus->pending_irqs = 1;
+	bus->pending_done_ns = bus->sda_low ? UINT64_MAX : s_now_ns + sim_bits_ns(2, bus->timing.scl_hz) + bus->timing.t_buf_ns;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c)
+{
+	SIM_I2C_Bus *bus = (SIM_I2C_Bus *)hi2c->Instance;
+	bus->stats.inits++;
+	hi2c->State = HAL_I2C_STATE_READY;
+	hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+
+	return HAL_OK;
+}
+
+// the transfer in flight is dropped without a callback
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c)
+{
+	SIM_I2C_Bus *bus = (SIM_I2C_Bus *)hi2c->Instance;
+	bus->pending = 0;
+	hi2c->State = HAL_I2C_STATE_RESET;
+
+	return HAL_OK;
+}
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef *hi2c)
+{
+	return hi2c->State;
+}
+
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef *hi2c)
+{
+	return hi2c->ErrorCode;
+}
+
+__attribute__((weak)) void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	(void)hi2c;
+}
+
+__attribute__((weak)) void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	(void)hi2c;
+}
+
+__attribute__((weak)) void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	(void)hi2c;
+}
+
+__attribute__((weak)) void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+	(void)hi2c;
+}
+
+__attribute__((weak)) void HAL_I2C_AbortCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	(void)hi2c;
+}
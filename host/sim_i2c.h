@@ -0,0 +1,119 @@
+/*
+ * sim_i2c.h
+ *
+ *  Simulated I2C bus behind the host main.h. Time is virtual: blocking
+ *  transfers advance the clock by their modeled duration, IT and DMA
+ *  transfers complete once the clock passes their end (HAL_GetTick() and
+ *  SIM_I2C_micros() polls advance it).
+ */
+
+#ifndef SIM_I2C_H_
+#define SIM_I2C_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+
+#define SIM_I2C_MAX_BUSES		4
+#define SIM_I2C_MAX_DEVICES		9
+#define SIM_I2C_POLL_CYCLES		12	// cycles per HAL_GetTick() poll in a spin loop
+#define SIM_I2C_ISR_CYCLES		150	// cycles per I2C interrupt (HAL EV handler)
+#define SIM_I2C_CPU_HZ			72000000
+#define SIM_I2C_FS_MAX_HZ		1000000	// above: Hs-mode
+
+typedef struct
+{
+	const char	*name;
+	uint32_t	scl_hz;
+	uint32_t	fs_hz;		// non-zero: Hs-mode, master code sent at this rate first
+	uint32_t	t_buf_ns;	// bus free time between STOP and next START
+} SIM_I2C_Timing;
+
+extern const SIM_I2C_Timing SIM_I2C_STANDARD;		// 100 kHz
+extern const SIM_I2C_Timing SIM_I2C_FAST;			// 400 kHz
+extern const SIM_I2C_Timing SIM_I2C_HIGH_SPEED;		// 3.4 MHz
+extern const SIM_I2C_Timing SIM_I2C_HIGH_SPEED_HELD;	// 3.4 MHz, no master code: only devices held in Hs-mode answer
+
+typedef enum
+{
+	SIM_I2C_FAULT_NONE		= 0,
+	SIM_I2C_FAULT_NACK		= 1,	// address not acknowledged
+	SIM_I2C_FAULT_ARLO		= 2,	// arbitration lost to another master
+	SIM_I2C_FAULT_BERR		= 3,	// misplaced START or STOP
+	SIM_I2C_FAULT_HANG		= 4,	// peripheral stops mid transfer, an abort gets it going again
+	SIM_I2C_FAULT_SDA_LOW	= 5,	// a slave holds SDA until a bus clear, every transfer hangs
+} SIM_I2C_Fault;
+
+typedef struct
+{
+	uint32_t	transactions;	// START .. STOP
+	uint32_t	starts;			// START and repeated START conditions
+	uint32_t	bytes;			// bytes on the wire, address bytes included
+	uint32_t	nacks;
+	uint32_t	interrupts;
+	uint64_t	bus_ns;			// time the bus was owned
+	uint64_t	spin_ns;		// time the CPU spent waiting on the bus
+	uint32_t	faults;			// injected faults hit
+	uint32_t	bus_clears;
+	uint32_t	inits;			// HAL_I2C_Init calls
+} SIM_I2C_Stats;
+
+typedef struct SIM_I2C_Device SIM_I2C_Device;
+
+struct SIM_I2C_Device
+{
+	uint8_t		address;	// 7-bit
+	uint8_t		broadcast;	// 7-bit write-only broadcast address, 0 = none
+	uint8_t		hs_mode;	// stays in Hs-mode after STOP, decodes Hs frames without a master code
+	void		(*write)(SIM_I2C_Device *device, const uint8_t *data, uint16_t size);
+	void		(*read)(SIM_I2C_Device *device, uint8_t *data, uint16_t size);
+};
+
+typedef struct
+{
+	I2C_HandleTypeDef	hi2c;
+	SIM_I2C_Timing		timing;
+	SIM_I2C_Stats		stats;
+	SIM_I2C_Device		*devices[SIM_I2C_MAX_DEVICES];
+	uint8_t				num_devices;
+
+	uint8_t				pending;		// IT or DMA transfer in flight
+	uint8_t				pending_rx;
+	uint8_t				pending_mem;	// Mem_Read: memory address, repeated START, receive
+	uint8_t				pending_mem_address;
+	uint32_t			pending_error;	// HAL_I2C_ERROR_* the transfer ends with
+	uint8_t				pending_abort;	// an abort is on its way to AbortCpltCallback
+	uint16_t			pending_irqs;	// interrupts taken when the transfer ends
+	uint16_t			pending_address;
+	uint8_t				*pending_data;
+	uint16_t			pending_size;
+	uint64_t			pending_done_ns;	// UINT64_MAX: hung
+
+	SIM_I2C_Fault		fault;
+	uint8_t				fault_count;	// transactions left that run into fault
+	uint8_t				sda_low;
+} SIM_I2C_Bus;
+
+void SIM_I2C_init(SIM_I2C_Bus *bus, const SIM_I2C_Timing *timing);
+void SIM_I2C_attach(SIM_I2C_Bus *bus, SIM_I2C_Device *device);
+void SIM_I2C_set_timing(SIM_I2C_Bus *bus, const SIM_I2C_Timing *timing); // bus clock reprogrammed, stats kept
+void SIM_I2C_reset_stats(SIM_I2C_Bus *bus);
+void SIM_I2C_inject(SIM_I2C_Bus *bus, const SIM_I2C_Fault fault, const uint8_t count); // the next count transactions
+void SIM_I2C_bus_clear(I2C_HandleTypeDef *hi2c); // DAC7678_BusClear: nine SCL pulses and a STOP
+
+uint64_t SIM_I2C_now_ns(void);
+uint32_t SIM_I2C_micros(void);			// DAC7678_TimeSource, costs a poll like HAL_GetTick()
+void SIM_I2C_set_micros_offset(uint32_t offset);	// moves SIM_I2C_micros() towards its wrap
+void SIM_I2C_advance_ns(uint64_t ns);	// CPU doing other work, bus keeps running
+void SIM_I2C_wait_idle(void);			// let every in-flight transfer finish
+
+void SIM_I2C_set_cpu_hz(uint32_t hz);
+uint64_t SIM_I2C_ns_to_cycles(uint64_t ns);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_I2C_H_ */
@@ -0,0 +1,80 @@
+/*
+ * sim_transport.c
+ */
+
+#include "sim_transport.h"
+
+SIM_Transport_Stats SIM_transport_stats;
+
+static uint8_t sim_transport_deliver(I2C_HandleTypeDef *hi2c, const uint8_t address, const uint8_t rx, uint8_t *data, const uint16_t size)
+{
+	SIM_I2C_Bus *bus = (SIM_I2C_Bus *)hi2c->Instance;
+	uint8_t acked = 0;
+
+	for (uint8_t i = 0; i < bus->num_devices; ++i)
+	{
+		SIM_I2C_Device *device = bus->devices[i];
+		if (device->address == address)
+		{
+			if (rx) device->read(device, data, size);
+			else device->write(device, data, size);
+			acked = 1;
+		}
+		else if (!rx && device->broadcast && device->broadcast == address)
+		{
+			device->write(device, data, size);
+			acked = 1;
+		}
+	}
+
+	if (!acked) SIM_transport_stats.nacks++;
+
+	return acked;
+}
+
+static DAC7678_State sim_transport_transmit(I2C_HandleTypeDef *hi2c, const uint8_t address, uint8_t *data, const uint16_t size)
+{
+	SIM_transport_stats.transmits++;
+
+	return sim_transport_deliver(hi2c, address, 0, data, size) ? DAC7678_OK : DAC7678_ERROR_TX;
+}
+
+static DAC7678_State sim_transport_write_read(I2C_HandleTypeDef *hi2c, const uint8_t address, const uint8_t command, uint8_t *data, const uint16_t size)
+{
+	SIM_transport_stats.write_reads++;
+
+	uint8_t pointer = command;
+	if (!sim_transport_deliver(hi2c, address, 0, &pointer, 1)) return DAC7678_ERROR_RX;
+
+	return sim_transport_deliver(hi2c, address, 1, data, size) ? DAC7678_OK : DAC7678_ERROR_RX;
+}
+
+static uint8_t sim_transport_is_ready(I2C_HandleTypeDef *hi2c)
+{
+	(void)hi2c;
+
+	return 1;
+}
+
+const DAC7678_Transport SIM_TRANSPORT =
+{
+	sim_transport_transmit, sim_transport_write_read, sim_transport_is_ready, 0
+};
+
+void SIM_clock_hook(I2C_HandleTypeDef *hi2c, const DAC7678_Speed speed)
+{
+	SIM_I2C_Bus *bus = (SIM_I2C_Bus *)hi2c->Instance;
+
+	switch (speed)
+	{
+	case DAC7678_SPEED_HS_MASTER_CODE:
+		SIM_I2C_set_timing(bus, &SIM_I2C_HIGH_SPEED);
+		break;
+	case DAC7678_SPEED_HS:
+		SIM_I2C_set_timing(bus, &SIM_I2C_HIGH_SPEED_HELD);
+		break;
+	default:
+		SIM_I2C_set_timing(bus, &SIM_I2C_FAST);
+		break;
+	}
+}
@@ -0,0 +1,36 @@
+/*
+ * sim_transport.h
+ *
+ *  DAC7678_Transport that hands frames straight to the devices attached to
+ *  a simulated bus: no bus time, no HAL, no interrupts. Lets the driver be
+ *  tested without the HAL I2C model in the loop. Also holds the clock hook
+ *  that switches a simulated bus between F/S- and Hs-mode.
+ */
+
+#ifndef SIM_TRANSPORT_H_
+#define SIM_TRANSPORT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "DAC7678.h"
+#include "sim_i2c.h"
+
+typedef struct
+{
+	uint32_t	transmits;
+	uint32_t	write_reads;
+	uint32_t	nacks;
+} SIM_Transport_Stats;
+
+extern const DAC7678_Transport SIM_TRANSPORT;
+extern SIM_Transport_Stats SIM_transport_stats;
+
+void SIM_clock_hook(I2C_HandleTypeDef *hi2c, const DAC7678_Speed speed); // DAC7678_ClockHook
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_TRANSPORT_H_ */
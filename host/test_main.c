@@ -0,0 +1,995 @@
+/*
+ * test_main.c
+ *
+ *  Runs the DAC7678_TEST suite from DAC7678.c against the simulated bus.
+ */
+
+#include <stdio.h>
+
+#include "DAC7678.h"
+#include "DAC7678_slew.h"
+#include "DAC7678_stream.h"
+#ifdef DAC7678_TRACE
+#include "DAC7678_trace.h"
+#endif
+#include "DAC7678_wave.h"
+#include "sim_dac7678.h"
+#include "sim_transport.h"
+
+#define DAC_ADDRESS 0x48
+
+static SIM_I2C_Bus s_bus;
+static SIM_DAC7678 s_model;
+static SIM_DAC7678 s_model2;
+static DAC7678 s_dac;
+static DAC7678 s_dac2;
+static int s_failed = 0;
+
+static void check(const char *name, const DAC7678_Test result)
+{
+	printf("%-36s %s\r\n", name, result == DAC7678_TST_PASS ? "pass" : "FAIL");
+	if (result != DAC7678_TST_PASS) s_failed++;
+}
+
+static uint8_t s_callbacks = 0;
+static DAC7678_State s_callback_state = DAC7678_NONE;
+
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	DAC7678_i2c_tx_cplt(hi2c);
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	DAC7678_i2c_rx_cplt(hi2c);
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+	DAC7678_i2c_error(hi2c);
+}
+
+void HAL_I2C_AbortCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	DAC7678_i2c_abort_cplt(hi2c);
+}
+
+static void on_done(DAC7678 *device, const DAC7678_State state, void *context)
+{
+	(void)device;
+	(void)context;
+	s_callbacks++;
+	s_callback_state = state;
+}
+
+static DAC7678_Test test_sim_queue(DAC7678 *device)
+{
+	SIM_I2C_wait_idle();
+	s_callbacks = 0;
+	DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_ON);
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		device->values[channel] = (uint16_t)(4000 - channel * 100);
+	}
+
+	const uint64_t spin = s_bus.stats.spin_ns;
+	if (DAC7678_set_values_async(device, on_done, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_set_value_async(device, DAC7678_CH_A, 7, on_done, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+#if defined(DAC7678_DMA) || defined(DAC7678_INTERRUPTS)
+	if (s_bus.stats.spin_ns != spin) return DAC7678_TST_FAIL; // queued calls must not spin
+	if (DAC7678_queue_pending(device) != DAC7678_MAX_CHANNELS + 1) return DAC7678_TST_FAIL;
+	if (DAC7678_set_values_async(device, on_done, NULL) != DAC7678_ERROR_QUEUE_FULL) return DAC7678_TST_FAIL;
+#else
+	(void)spin;
+#endif
+
+	if (DAC7678_flush(device) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (s_callbacks != 2 || s_callback_state != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (s_model.dac[0] != 7) return DAC7678_TST_FAIL;
+	for (uint8_t channel = 1; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (s_model.dac[channel] != 4000 - channel * 100) return DAC7678_TST_FAIL;
+	}
+
+	return DAC7678_TST_PASS;
+}
+
+static DAC7678_Test test_sim_read_async(DAC7678 *device)
+{
+	SIM_I2C_wait_idle();
+	s_callbacks = 0;
+	DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_ON);
+	if (DAC7678_set_value(device, DAC7678_CH_B, 3210) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_set_power_reg(device, DAC7678_PWR_PLDOWN_100K, DAC7678_CHM_H) != DAC7678_OK) return DAC7678_TST_FAIL;
+
+	uint16_t value = 0;
+	DAC7678_PowerOptions options = DAC7678_PWR_ON;
+	DAC7678_ChannelMsk channel_mask = DAC7678_CHM_NONE;
+	if (DAC7678_get_dac_reg_async(device, DAC7678_CH_B, &value, on_done, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_get_power_reg_async(device, &options, &channel_mask, on_done, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+#if defined(DAC7678_DMA) || defined(DAC7678_INTERRUPTS)
+	if (value != 0 || s_callbacks != 0) return DAC7678_TST_FAIL; // nothing decoded before the receive
+	if (DAC7678_queue_pending(device) != 2) return DAC7678_TST_FAIL;
+#endif
+
+	if (DAC7678_flush(device) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (s_callbacks != 2 || s_callback_state != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (value != 3210) return DAC7678_TST_FAIL;
+	if (options != DAC7678_PWR_PLDOWN_100K || channel_mask != DAC7678_CHM_H) return DAC7678_TST_FAIL;
+
+	return DAC7678_set_power_reg(device, DAC7678_PWR_ON, DAC7678_CHM_ALL) == DAC7678_OK ? DAC7678_TST_PASS : DAC7678_TST_FAIL;
+}
+
+static DAC7678_Test test_sim_pipelined(DAC7678 *device)
+{
+	SIM_I2C_wait_idle();
+	DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_ON);
+
+	// back to back, each frame is staged while the previous one is on the wire
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (DAC7678_set_value(device, (DAC7678_ChannelIdx)channel, (uint16_t)(100 + channel)) != DAC7678_OK) return DAC7678_TST_FAIL;
+	}
+	SIM_I2C_wait_idle();
+
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (s_model.dac[channel] != 100 + channel) return DAC7678_TST_FAIL;
+	}
+
+	return DAC7678_TST_PASS;
+}
+
+static DAC7678_Test test_sim_cache(DAC7678 *device)
+{
+	DAC7678_ClearOptions options = DAC7678_CLR_NONE;
+	SIM_I2C_wait_idle();
+	DAC7678_init(device, &s_bus.hi2c, DAC_ADDRESS);
+
+	DAC7678_set_cache_policy(device, DAC7678_CACHE_ONLY, 0);
+	if (DAC7678_get_clear_reg(device, &options) != DAC7678_ERROR_NOT_CACHED) return DAC7678_TST_FAIL;
+	if (DAC7678_set_clear_reg(device, DAC7678_CLR_MID) != DAC7678_OK) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+
+	// answered from the mirror, nothing on the bus
+	const uint32_t transactions = s_bus.stats.transactions;
+	if (DAC7678_get_clear_reg(device, &options) != DAC7678_OK || options != DAC7678_CLR_MID) return DAC7678_TST_FAIL;
+	if (s_bus.stats.transactions != transactions) return DAC7678_TST_FAIL;
+
+	// the part resets behind our back, the next verify read catches it
+	DAC7678_set_cache_policy(device, DAC7678_CACHE_VERIFY, 10);
+	SIM_DAC7678_reset(&s_model);
+	if (DAC7678_get_clear_reg(device, &options) != DAC7678_OK || options != DAC7678_CLR_MID) return DAC7678_TST_FAIL;
+	SIM_I2C_advance_ns(10000000ULL);
+	if (DAC7678_get_clear_reg(device, &options) != DAC7678_OK || options != DAC7678_CLR_ZERO) return DAC7678_TST_FAIL;
+	if (device->cache_mismatches != 1 || s_bus.stats.transactions != transactions + 1) return DAC7678_TST_FAIL;
+
+	DAC7678_set_cache_policy(device, DAC7678_CACHE_OFF, 0);
+
+	return DAC7678_TST_PASS;
+}
+
+static DAC7678_Test test_sim_bus(DAC7678 *device)
+{
+	SIM_I2C_wait_idle();
+	s_callbacks = 0;
+	SIM_DAC7678_init(&s_model2, DAC_ADDRESS + 1);
+	SIM_I2C_attach(&s_bus, &s_model2.device);
+	if (DAC7678_init(&s_dac2, &s_bus.hi2c, DAC_ADDRESS + 1) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (s_dac2.m_bus != device->m_bus) return DAC7678_TST_FAIL;
+
+	DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_ON);
+	DAC7678_set_write_options(&s_dac2, DAC7678_WRT_UPDATE_ON);
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		device->values[channel] = (uint16_t)(10 + channel);
+		s_dac2.values[channel] = (uint16_t)(20 + channel);
+	}
+
+	// both queues share the bus, neither caller waits for the other
+	const uint64_t spin = s_bus.stats.spin_ns;
+	if (DAC7678_set_values_async(device, on_done, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_set_values_async(&s_dac2, on_done, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+#if defined(DAC7678_DMA) || defined(DAC7678_INTERRUPTS)
+	if (s_bus.stats.spin_ns != spin) return DAC7678_TST_FAIL;
+	if (DAC7678_bus_pending(device->m_bus) != 2 * DAC7678_MAX_CHANNELS) return DAC7678_TST_FAIL;
+#else
+	(void)spin;
+#endif
+	if (DAC7678_bus_flush(device->m_bus) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (s_callbacks != 2 || s_callback_state != DAC7678_OK) return DAC7678_TST_FAIL;
+
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (s_model.dac[channel] != 10 + channel) return DAC7678_TST_FAIL;
+		if (s_model2.dac[channel] != 20 + channel) return DAC7678_TST_FAIL;
+	}
+
+	// a chip with transfers still queued or on the wire is not torn down
+	if (s_dac2.m_transport->async)
+	{
+		if (DAC7678_set_value_async(&s_dac2, DAC7678_CH_B, 40, on_done, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+		if (DAC7678_deinit(&s_dac2) != DAC7678_ERROR || !s_dac2.m_init) return DAC7678_TST_FAIL;
+		if (DAC7678_flush(&s_dac2) != DAC7678_OK || s_model2.dac[1] != 40) return DAC7678_TST_FAIL;
+	}
+
+	// tearing one chip down leaves the other running
+	if (DAC7678_deinit(&s_dac2) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_set_value(device, DAC7678_CH_A, 30) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_set_value(&s_dac2, DAC7678_CH_A, 30) != DAC7678_ERROR) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+	if (s_model.dac[0] != 30 || s_model2.dac[0] != 20) return DAC7678_TST_FAIL;
+
+	return DAC7678_TST_PASS;
+}
+
+static DAC7678_Test test_sim_group(DAC7678 *device)
+{
+	SIM_I2C_wait_idle();
+	if (DAC7678_init(&s_dac2, &s_bus.hi2c, DAC_ADDRESS + 1) != DAC7678_OK) return DAC7678_TST_FAIL;
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		device->values[channel] = (uint16_t)(1000 + channel);
+		s_dac2.values[channel] = (uint16_t)(2000 + channel);
+	}
+
+	if (DAC7678_bus_set_values(device->m_bus) != DAC7678_OK) return DAC7678_TST_FAIL;
+#if defined(DAC7678_DMA) || defined(DAC7678_INTERRUPTS)
+	// inputs loaded on both chips, outputs wait for the broadcast still on the wire
+	if (s_model.input[7] != 1007 || s_model2.input[7] != 2007) return DAC7678_TST_FAIL;
+	if (s_model.dac[7] == 1007 || s_model2.dac[7] == 2007) return DAC7678_TST_FAIL;
+#endif
+	SIM_I2C_wait_idle();
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (s_model.dac[channel] != 1000 + channel) return DAC7678_TST_FAIL;
+		if (s_model2.dac[channel] != 2000 + channel) return DAC7678_TST_FAIL;
+	}
+
+	// next frame, one channel moved: one load and one update for the whole bus
+	const uint32_t transactions = s_bus.stats.transactions;
+	s_dac2.values[4] = 42;
+	if (DAC7678_bus_set_values(device->m_bus) != DAC7678_OK) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+	if (s_bus.stats.transactions != transactions + 2 || s_model2.dac[4] != 42) return DAC7678_TST_FAIL;
+
+	return DAC7678_deinit(&s_dac2) == DAC7678_OK ? DAC7678_TST_PASS : DAC7678_TST_FAIL;
+}
+
+static DAC7678_Test test_sim_wave(DAC7678 *device)
+{
+	static uint16_t saw[16];
+	static uint16_t sine[64];
+	DAC7678_Wave wave;
+	SIM_I2C_wait_idle();
+
+	if (DAC7678_wave_fill(saw, 16, DAC7678_WAVE_SAW, 1500, 100) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_wave_fill(sine, 64, DAC7678_WAVE_SINE, 4000, 0) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (saw[0] != 100 || saw[15] != 1600 || sine[0] != 2000 || sine[16] != 4000 || sine[48] != 0) return DAC7678_TST_FAIL;
+
+	// 1 kHz ticks; A walks the saw one entry per tick, B the sine two entries per tick
+	if (DAC7678_wave_init(&wave, device, 1000) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_wave_set_table(&wave, DAC7678_CH_A, saw, 16) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_wave_set_table(&wave, DAC7678_CH_B, sine, 64) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_wave_set_frequency(&wave, DAC7678_CH_A, 62500) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_wave_set_frequency(&wave, DAC7678_CH_B, 31250) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_wave_set_frequency(&wave, DAC7678_CH_B, 600000) != DAC7678_ERROR_INVALID_VALUE) return DAC7678_TST_FAIL;
+	if (DAC7678_wave_start(&wave, DAC7678_CHM_A | DAC7678_CHM_B) != DAC7678_OK) return DAC7678_TST_FAIL;
+
+	for (uint8_t tick = 0; tick < 40; ++tick)
+	{
+		DAC7678_wave_tick(&wave);
+		SIM_I2C_advance_ns(1000000ULL);
+		if (s_model.dac[0] != saw[tick % 16]) return DAC7678_TST_FAIL;
+		if (s_model.dac[1] != sine[(2 * tick) % 64]) return DAC7678_TST_FAIL;
+	}
+
+	// B swaps to the shorter saw while running, the phase keeps its place in the cycle
+	if (DAC7678_wave_set_table(&wave, DAC7678_CH_B, saw, 16) != DAC7678_OK) return DAC7678_TST_FAIL;
+	for (uint8_t tick = 40; tick < 48; ++tick)
+	{
+		DAC7678_wave_tick(&wave);
+		SIM_I2C_advance_ns(1000000ULL);
+		if (s_model.dac[0] != saw[tick % 16]) return DAC7678_TST_FAIL;
+		if (s_model.dac[1] != saw[((2 * tick) % 64) / 4]) return DAC7678_TST_FAIL;
+	}
+
+	DAC7678_wave_stop(&wave, DAC7678_CHM_ALL);
+	DAC7678_wave_tick(&wave);
+	if (wave.ticks != 48 || wave.dropped != 0) return DAC7678_TST_FAIL;
+
+	return DAC7678_TST_PASS;
+}
+
+static DAC7678_Test test_sim_dds(DAC7678 *device)
+{
+	DAC7678_Wave wave;
+	SIM_I2C_wait_idle();
+
+	if (DAC7678_wave_sine_lut[0] != 2048 || DAC7678_wave_sine_lut[DAC7678_WAVE_LUT_SIZE / 4] != DAC7678_MAX_VALUE) return DAC7678_TST_FAIL;
+	if (DAC7678_wave_sine_lut[3 * DAC7678_WAVE_LUT_SIZE / 4] != 0) return DAC7678_TST_FAIL;
+
+	// eight channels on one tuning word, each 45 degrees behind the previous one
+	const uint32_t step = 1UL << (32 - DAC7678_WAVE_LUT_BITS + 3); // 8 entries per tick
+	if (DAC7678_wave_init(&wave, device, 1000) != DAC7678_OK) return DAC7678_TST_FAIL;
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (DAC7678_wave_set_sine(&wave, channel) != DAC7678_OK) return DAC7678_TST_FAIL;
+		if (DAC7678_wave_set_step(&wave, channel, step) != DAC7678_OK) return DAC7678_TST_FAIL;
+		if (DAC7678_wave_set_phase(&wave, channel, channel * DAC7678_WAVE_DEGREES(45)) != DAC7678_OK) return DAC7678_TST_FAIL;
+	}
+	if (DAC7678_wave_set_step(&wave, DAC7678_CH_A, 0x80000001UL) != DAC7678_ERROR_INVALID_VALUE) return DAC7678_TST_FAIL;
+	if (DAC7678_wave_start(&wave, DAC7678_CHM_ALL) != DAC7678_OK) return DAC7678_TST_FAIL;
+
+	for (uint8_t tick = 0; tick < 20; ++tick)
+	{
+		DAC7678_wave_tick(&wave);
+		SIM_I2C_advance_ns(1000000ULL);
+		for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+		{
+			const uint32_t index = (tick * 8U + channel * DAC7678_WAVE_LUT_SIZE / 8U) % DAC7678_WAVE_LUT_SIZE;
+			if (s_model.dac[channel] != DAC7678_wave_sine_lut[index]) return DAC7678_TST_FAIL;
+		}
+	}
+
+	DAC7678_wave_stop(&wave, DAC7678_CHM_ALL);
+	SIM_I2C_wait_idle();
+	if (wave.dropped != 0) return DAC7678_TST_FAIL;
+
+	return DAC7678_TST_PASS;
+}
+
+static uint8_t s_slew_landed;
+static DAC7678_State s_slew_state;
+static void *s_slew_context;
+
+static void test_slew_landed(DAC7678_Slew *slew, const DAC7678_ChannelIdx channel, const DAC7678_State state, void *context)
+{
+	(void)slew;
+	s_slew_landed |= (uint8_t)(1 << channel);
+	s_slew_context = context;
+	if (state != DAC7678_OK) s_slew_state = state;
+}
+
+static DAC7678_Test test_sim_slew(DAC7678 *device)
+{
+	static const uint16_t ramp_a[] = { 1030, 1060, 1090, 1100, 1100, 1100 };
+	static const uint16_t ramp_b[] = { 950, 900, 900, 900, 900, 900 };
+	DAC7678_Slew slew;
+
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		device->values[channel] = 1000;
+	}
+	if (DAC7678_set_values(device) != DAC7678_OK) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+
+	s_slew_landed = DAC7678_CHM_NONE;
+	s_slew_state = DAC7678_OK;
+	if (DAC7678_slew_init(&slew, device) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_slew_to(&slew, DAC7678_CH_A, 1100, 30, test_slew_landed, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_slew_to(&slew, DAC7678_CH_B, 900, 50, test_slew_landed, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_slew_to(&slew, DAC7678_CH_C, 4096, 1, NULL, NULL) != DAC7678_ERROR_INVALID_VALUE) return DAC7678_TST_FAIL;
+	if (DAC7678_slew_busy(&slew) != (DAC7678_CHM_A | DAC7678_CHM_B)) return DAC7678_TST_FAIL;
+
+	for (uint8_t tick = 0; tick < 6; ++tick)
+	{
+		DAC7678_slew_tick(&slew);
+		SIM_I2C_wait_idle();
+		if (s_model.dac[0] != ramp_a[tick] || s_model.dac[1] != ramp_b[tick] || s_model.dac[2] != 1000) return DAC7678_TST_FAIL;
+		if (tick == 1 && s_slew_landed != DAC7678_CHM_B) return DAC7678_TST_FAIL;
+	}
+
+	if (s_slew_landed != (DAC7678_CHM_A | DAC7678_CHM_B) || s_slew_state != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_slew_busy(&slew) != DAC7678_CHM_NONE || slew.ticks != 4 || slew.dropped != 0) return DAC7678_TST_FAIL;
+
+	// retargeted after its last tick, before that write lands: the finished ramp reports to its own callback
+	static uint8_t first, second;
+	s_slew_landed = DAC7678_CHM_NONE;
+	s_slew_context = NULL;
+	if (DAC7678_slew_to(&slew, DAC7678_CH_A, 1120, 30, test_slew_landed, &first) != DAC7678_OK) return DAC7678_TST_FAIL;
+	DAC7678_slew_tick(&slew);
+	if (DAC7678_slew_busy(&slew) != DAC7678_CHM_NONE) return DAC7678_TST_FAIL;
+	if (DAC7678_slew_to(&slew, DAC7678_CH_A, 1200, 50, test_slew_landed, &second) != DAC7678_OK) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+	if (s_slew_landed != DAC7678_CHM_A || s_slew_context != &first || s_model.dac[0] != 1120) return DAC7678_TST_FAIL;
+	s_slew_landed = DAC7678_CHM_NONE;
+	DAC7678_slew_tick(&slew);
+	SIM_I2C_wait_idle();
+	if (s_slew_landed != DAC7678_CHM_NONE) return DAC7678_TST_FAIL;
+	DAC7678_slew_tick(&slew);
+	SIM_I2C_wait_idle();
+	if (s_slew_landed != DAC7678_CHM_A || s_slew_context != &second || s_model.dac[0] != 1200) return DAC7678_TST_FAIL;
+
+	return DAC7678_TST_PASS;
+}
+
+static uint8_t s_stream_low;
+
+static void test_stream_low(DAC7678_Stream *stream, const DAC7678_ChannelIdx channel, const uint16_t level, void *context)
+{
+	(void)stream;
+	(void)context;
+	if (level == 2) s_stream_low |= (uint8_t)(1 << channel);
+}
+
+static DAC7678_Test test_sim_stream(DAC7678 *device)
+{
+	static uint16_t ring_a[8], ring_b[8], ring_c[8];
+	static const uint16_t samples_a[] = { 100, 200, 300 };
+	static const uint16_t samples_b[] = { 400, 500 };
+	static const uint16_t samples_c[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+	static const uint16_t samples_bad[] = { 600, 4096, 700 };
+	DAC7678_Stream stream;
+	SIM_I2C_wait_idle();
+
+	s_stream_low = DAC7678_CHM_NONE;
+	if (DAC7678_stream_init(&stream, device, DAC7678_STREAM_LOCKSTEP, test_stream_low, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_stream_set_buffer(&stream, DAC7678_CH_A, ring_a, 8, 2) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_stream_set_buffer(&stream, DAC7678_CH_B, ring_b, 8, 2) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_stream_set_buffer(&stream, DAC7678_CH_C, ring_c, 6, 2) != DAC7678_ERROR_INVALID_VALUE) return DAC7678_TST_FAIL;
+	if (DAC7678_stream_set_buffer(&stream, DAC7678_CH_C, ring_c, 8, 2) != DAC7678_OK) return DAC7678_TST_FAIL;
+
+	if (DAC7678_stream_push(&stream, DAC7678_CH_A, samples_a, 3) != 3) return DAC7678_TST_FAIL;
+	if (DAC7678_stream_push(&stream, DAC7678_CH_B, samples_b, 2) != 2) return DAC7678_TST_FAIL;
+	if (DAC7678_stream_push(&stream, DAC7678_CH_C, samples_c, 9) != 8) return DAC7678_TST_FAIL;
+	if (stream.m_channels[DAC7678_CH_C].overruns != 1 || DAC7678_stream_level(&stream, DAC7678_CH_C) != 8) return DAC7678_TST_FAIL;
+	if (DAC7678_stream_push(&stream, DAC7678_CH_D, samples_bad, 3) != 0) return DAC7678_TST_FAIL;
+	if (DAC7678_stream_start(&stream, DAC7678_CHM_A | DAC7678_CHM_B) != DAC7678_OK) return DAC7678_TST_FAIL;
+	const uint16_t dac_c = s_model.dac[2];
+
+	// lockstep: both channels play together, then nothing once B runs dry
+	DAC7678_stream_tick(&stream);
+	SIM_I2C_wait_idle();
+	if (s_model.dac[0] != 100 || s_model.dac[1] != 400 || s_stream_low != DAC7678_CHM_A) return DAC7678_TST_FAIL;
+	DAC7678_stream_tick(&stream);
+	SIM_I2C_wait_idle();
+	if (s_model.dac[0] != 200 || s_model.dac[1] != 500) return DAC7678_TST_FAIL;
+	DAC7678_stream_tick(&stream);
+	SIM_I2C_wait_idle();
+	if (s_model.dac[0] != 200 || DAC7678_stream_level(&stream, DAC7678_CH_A) != 1) return DAC7678_TST_FAIL;
+
+	// free running: A plays its last sample while B holds
+	DAC7678_stream_set_mode(&stream, DAC7678_STREAM_FREE);
+	DAC7678_stream_tick(&stream);
+	SIM_I2C_wait_idle();
+	if (s_model.dac[0] != 300 || s_model.dac[1] != 500 || s_model.dac[2] != dac_c) return DAC7678_TST_FAIL;
+	if (stream.m_channels[DAC7678_CH_B].underruns != 2 || stream.m_channels[DAC7678_CH_A].underruns != 0) return DAC7678_TST_FAIL;
+	if (stream.ticks != 3 || stream.dropped != 0) return DAC7678_TST_FAIL;
+
+	// a rejected sample ends the push
+	if (DAC7678_stream_push(&stream, DAC7678_CH_A, samples_bad, 3) != 1) return DAC7678_TST_FAIL;
+	DAC7678_stream_stop(&stream, DAC7678_CHM_ALL);
+
+	return DAC7678_TST_PASS;
+}
+
+static DAC7678_Test test_sim_calibration(DAC7678 *device)
+{
+	static const int16_t inl[] = { 0, 32, 0 }; // +2 LSB bow at mid scale
+	SIM_I2C_wait_idle();
+	DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_ON);
+
+	if (DAC7678_set_calibration(device, DAC7678_CH_A, DAC7678_CAL_Q16(1.01), DAC7678_CAL_Q16(-3.0)) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_set_calibration(device, DAC7678_CH_A, DAC7678_CAL_Q16(2.5), 0) != DAC7678_ERROR_INVALID_VALUE) return DAC7678_TST_FAIL;
+	if (DAC7678_set_inl(device, DAC7678_CH_B, inl, 1) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_calibrate(device, DAC7678_CH_A, 2000) != 2017 || DAC7678_calibrate(device, DAC7678_CH_A, 0) != 0) return DAC7678_TST_FAIL;
+	if (DAC7678_calibrate(device, DAC7678_CH_A, DAC7678_MAX_VALUE) != DAC7678_MAX_VALUE) return DAC7678_TST_FAIL;
+	if (DAC7678_calibrate(device, DAC7678_CH_B, 2048) != 2046 || DAC7678_calibrate(device, DAC7678_CH_B, 1024) != 1023) return DAC7678_TST_FAIL;
+	if (DAC7678_calibrate(device, DAC7678_CH_C, 1234) != 1234) return DAC7678_TST_FAIL;
+
+	if (DAC7678_set_value(device, DAC7678_CH_A, 2000) != DAC7678_OK) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+	if (s_model.dac[0] != 2017) return DAC7678_TST_FAIL;
+
+	// a broadcast becomes one corrected write per channel
+	if (DAC7678_set_value(device, DAC7678_CH_ALL, 1000) != DAC7678_OK) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+	if (s_model.dac[0] != 1007 || s_model.dac[1] != DAC7678_calibrate(device, DAC7678_CH_B, 1000) || s_model.dac[2] != 1000) return DAC7678_TST_FAIL;
+
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		device->values[channel] = 500;
+	}
+	if (DAC7678_set_values_async(device, NULL, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+	if (s_model.dac[0] != 502 || s_model.dac[1] != DAC7678_calibrate(device, DAC7678_CH_B, 500) || s_model.dac[7] != 500) return DAC7678_TST_FAIL;
+
+	uint16_t burst[2] = { 100, 200 };
+	if (DAC7678_set_value_burst(device, DAC7678_CH_ALL, burst, 2) != DAC7678_ERROR_INVALID_CHANNEL) return DAC7678_TST_FAIL;
+
+	DAC7678_clear_calibration(device, DAC7678_CHM_ALL);
+	if (DAC7678_set_value(device, DAC7678_CH_A, 2000) != DAC7678_OK) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+	if (s_model.dac[0] != 2000) return DAC7678_TST_FAIL;
+
+	return DAC7678_TST_PASS;
+}
+
+static DAC7678_Test test_sim_units(DAC7678 *device)
+{
+	SIM_I2C_wait_idle();
+	DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_ON);
+
+	if (DAC7678_units_to_code(1000, DAC7678_UNIT_SCALE(DAC7678_VREF_INTERNAL_MV)) != 1638) return DAC7678_TST_FAIL;
+	if (DAC7678_code_to_units(2048, DAC7678_VREF_INTERNAL_MV) != 1250) return DAC7678_TST_FAIL;
+
+	// internal reference by default
+	if (DAC7678_set_units(device, DAC7678_CH_A, 1250) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_set_units(device, DAC7678_CH_A, DAC7678_VREF_INTERNAL_MV) != DAC7678_ERROR_INVALID_VALUE) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+	if (s_model.dac[0] != 2048) return DAC7678_TST_FAIL;
+
+	// 0 .. 24 mA current loop, units in uA
+	if (DAC7678_set_full_scale(device, 24000) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_set_units_async(device, DAC7678_CH_B, 12000, NULL, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_set_units(device, DAC7678_CH_C, 4000) != DAC7678_OK) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+	if (s_model.dac[1] != 2048 || s_model.dac[2] != 683) return DAC7678_TST_FAIL;
+
+	DAC7678_set_full_scale(device, DAC7678_VREF_INTERNAL_MV);
+
+	return DAC7678_TST_PASS;
+}
+
+static DAC7678_Test test_sim_registers(DAC7678 *device)
+{
+	DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_OFF);
+	if (DAC7678_set_value(device, DAC7678_CH_C, 1234) != DAC7678_OK) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+	if (s_model.input[2] != 1234 || s_model.dac[2] == 1234) return DAC7678_TST_FAIL;
+
+	if (DAC7678_update_dac_reg(device, DAC7678_CH_C) != DAC7678_OK) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+	if (s_model.dac[2] != 1234) return DAC7678_TST_FAIL;
+
+	DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_ON);
+	if (DAC7678_set_value(device, DAC7678_CH_ALL, 4095) != DAC7678_OK) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (s_model.dac[channel] != 4095) return DAC7678_TST_FAIL;
+	}
+
+	return DAC7678_TST_PASS;
+}
+
+static DAC7678_Test test_sim_transport(DAC7678 *device)
+{
+	SIM_I2C_wait_idle();
+	s_callbacks = 0;
+	s_callback_state = DAC7678_NONE;
+	const uint32_t transactions = s_bus.stats.transactions;
+	const SIM_Transport_Stats stats = SIM_transport_stats;
+
+	// mock transport: frames go straight to the model, the HAL bus never sees them
+	if (DAC7678_init_transport(&s_dac2, &s_bus.hi2c, DAC_ADDRESS + 1, &SIM_TRANSPORT) != DAC7678_OK) return DAC7678_TST_FAIL;
+	DAC7678_set_write_options(&s_dac2, DAC7678_WRT_UPDATE_ON);
+	if (DAC7678_set_value(&s_dac2, DAC7678_CH_B, 1234) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (s_model2.dac[1] != 1234) return DAC7678_TST_FAIL;
+
+	uint16_t value = 0;
+	if (DAC7678_get_value(&s_dac2, DAC7678_CH_B, &value) != DAC7678_OK || value != 1234) return DAC7678_TST_FAIL;
+
+	// a synchronous transport completes async calls before they return
+	if (DAC7678_set_value_async(&s_dac2, DAC7678_CH_C, 2345, on_done, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (s_callbacks != 1 || s_callback_state != DAC7678_OK || s_model2.dac[2] != 2345) return DAC7678_TST_FAIL;
+
+	if (s_bus.stats.transactions != transactions) return DAC7678_TST_FAIL;
+	if (SIM_transport_stats.transmits != stats.transmits + 2 || SIM_transport_stats.write_reads != stats.write_reads + 1) return DAC7678_TST_FAIL;
+	if (DAC7678_deinit(&s_dac2) != DAC7678_OK) return DAC7678_TST_FAIL;
+
+	// a blocking device next to the default one: the blocking write waits for the queue,
+	// and the queue carries on after it
+	if (DAC7678_init_transport(&s_dac2, &s_bus.hi2c, DAC_ADDRESS + 1, &DAC7678_TRANSPORT_BLOCKING) != DAC7678_OK) return DAC7678_TST_FAIL;
+	DAC7678_set_write_options(&s_dac2, DAC7678_WRT_UPDATE_ON);
+	DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_ON);
+	s_callbacks = 0;
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (DAC7678_set_value_async(device, channel, (uint16_t)(300 + channel), on_done, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+	}
+	if (DAC7678_set_value(&s_dac2, DAC7678_CH_D, 3456) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (s_model2.dac[3] != 3456) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+	if (s_callbacks != DAC7678_MAX_CHANNELS) return DAC7678_TST_FAIL;
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel)
+	{
+		if (s_model.dac[channel] != 300 + channel) return DAC7678_TST_FAIL;
+	}
+
+	return DAC7678_deinit(&s_dac2) == DAC7678_OK ? DAC7678_TST_PASS : DAC7678_TST_FAIL;
+}
+
+static DAC7678_Test test_sim_hs(DAC7678 *device)
+{
+	SIM_I2C_wait_idle();
+	DAC7678_Bus *bus = device->m_bus;
+	DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_ON);
+
+	// without the session a held Hs clock reaches no chip
+	SIM_clock_hook(&s_bus.hi2c, DAC7678_SPEED_HS);
+	DAC7678_set_value(device, DAC7678_CH_A, 111);
+	SIM_I2C_wait_idle();
+	SIM_clock_hook(&s_bus.hi2c, DAC7678_SPEED_FAST);
+	if (s_model.dac[0] == 111) return DAC7678_TST_FAIL;
+
+	if (DAC7678_bus_hs_enter(bus, SIM_clock_hook) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (!DAC7678_bus_hs_active(bus)) return DAC7678_TST_FAIL;
+	if (s_bus.timing.scl_hz != 3400000 || s_bus.timing.fs_hz != 0) return DAC7678_TST_FAIL;
+	if (!s_model.device.hs_mode || !s_model2.device.hs_mode) return DAC7678_TST_FAIL;
+
+	// no master code: one START per write
+	SIM_I2C_reset_stats(&s_bus);
+	if (DAC7678_set_value(device, DAC7678_CH_B, 2222) != DAC7678_OK) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+	if (s_model.dac[1] != 2222 || s_bus.stats.starts != 1 || s_bus.stats.nacks != 0) return DAC7678_TST_FAIL;
+
+	// a plain reset keeps the chip in Hs-mode while the session is open
+	if (DAC7678_reset(device, DAC7678_RST) != DAC7678_OK) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+	if (!s_model.device.hs_mode || s_model.dac[1] != 0) return DAC7678_TST_FAIL;
+	uint16_t value = 0;
+	if (DAC7678_set_value(device, DAC7678_CH_C, 3333) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_get_value(device, DAC7678_CH_C, &value) != DAC7678_OK || value != 3333) return DAC7678_TST_FAIL;
+
+	if (DAC7678_bus_hs_exit(bus) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_bus_hs_active(bus) || s_model.device.hs_mode || s_bus.timing.scl_hz != 400000) return DAC7678_TST_FAIL;
+	if (DAC7678_set_value(device, DAC7678_CH_D, 444) != DAC7678_OK) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+
+	return s_model.dac[3] == 444 ? DAC7678_TST_PASS : DAC7678_TST_FAIL;
+}
+
+static DAC7678_Test test_sim_recovery(DAC7678 *device)
+{
+	SIM_I2C_wait_idle();
+	DAC7678_Bus *bus = device->m_bus;
+	DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_ON);
+	const uint32_t retries = bus->retries;
+	const uint32_t recoveries = bus->recoveries;
+
+	// a glitch on a queued write costs one repeated frame
+	s_callbacks = 0;
+	SIM_I2C_inject(&s_bus, SIM_I2C_FAULT_NACK, 1);
+	if (DAC7678_set_value_async(device, DAC7678_CH_A, 100, on_done, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_flush(device) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (s_callbacks != 1 || s_callback_state != DAC7678_OK || s_model.dac[0] != 100) return DAC7678_TST_FAIL;
+	if (bus->retries != retries + 1) return DAC7678_TST_FAIL;
+
+	// and on a direct one
+	SIM_I2C_inject(&s_bus, SIM_I2C_FAULT_ARLO, 1);
+	if (DAC7678_set_value(device, DAC7678_CH_B, 200) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_flush(device) != DAC7678_OK || s_model.dac[1] != 200) return DAC7678_TST_FAIL;
+
+	// a bus error re-inits the peripheral before the retry
+	const uint32_t inits = s_bus.stats.inits;
+	SIM_I2C_inject(&s_bus, SIM_I2C_FAULT_BERR, 1);
+	if (DAC7678_set_value(device, DAC7678_CH_C, 300) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_flush(device) != DAC7678_OK || s_model.dac[2] != 300) return DAC7678_TST_FAIL;
+	if (bus->recoveries != recoveries + 1 || s_bus.stats.inits != inits + 1) return DAC7678_TST_FAIL;
+
+	// the error interrupt only asks for the re-init; a poll from a timer interrupt leaves it to the thread-context service
+	SIM_I2C_inject(&s_bus, SIM_I2C_FAULT_BERR, 1);
+	if (DAC7678_set_value_async(device, DAC7678_CH_C, 350, NULL, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+	SIM_I2C_wait_idle();
+	DAC7678_bus_poll(bus);
+	if (device->m_transport->async && (!bus->m_recover || bus->recoveries != recoveries + 1 || s_model.dac[2] != 300)) return DAC7678_TST_FAIL;
+	DAC7678_bus_service(bus);
+	if (bus->m_recover || bus->recoveries != recoveries + 2 || s_bus.stats.inits != inits + 2) return DAC7678_TST_FAIL;
+	if (DAC7678_flush(device) != DAC7678_OK || s_model.dac[2] != 350) return DAC7678_TST_FAIL;
+
+	// a chip that keeps NACKing is reported once the retries are spent, mapped to its cause
+	s_callbacks = 0;
+	SIM_I2C_inject(&s_bus, SIM_I2C_FAULT_NACK, DAC7678_RETRIES + 1);
+	DAC7678_set_value_async(device, DAC7678_CH_D, 400, on_done, NULL);
+	DAC7678_flush(device);
+	if (s_callbacks != 1 || s_callback_state != DAC7678_ERROR_NACK || s_model.dac[3] == 400) return DAC7678_TST_FAIL;
+
+	SIM_I2C_inject(&s_bus, SIM_I2C_FAULT_NACK, DAC7678_RETRIES + 1);
+	DAC7678_State state = DAC7678_set_value(device, DAC7678_CH_D, 400);
+	if (state == DAC7678_OK) state = DAC7678_flush(device);
+	if (state != DAC7678_ERROR_NACK || DAC7678_get_error(device) != DAC7678_OK) return DAC7678_TST_FAIL;
+
+	// a hung transfer and a slave holding SDA cost a few stall periods, not DAC7678_TIMEOUT
+	SIM_I2C_inject(&s_bus, SIM_I2C_FAULT_HANG, 1);
+	uint64_t start = SIM_I2C_now_ns();
+	if (DAC7678_set_value_async(device, DAC7678_CH_E, 500, NULL, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_flush(device) != DAC7678_OK || s_model.dac[4] != 500) return DAC7678_TST_FAIL;
+	if (SIM_I2C_now_ns() - start > 3ULL * DAC7678_STALL_TIMEOUT_US * 1000ULL) return DAC7678_TST_FAIL;
+
+	DAC7678_bus_set_recovery(bus, SIM_I2C_bus_clear, DAC7678_RETRIES);
+	SIM_I2C_inject(&s_bus, SIM_I2C_FAULT_SDA_LOW, 1);
+	start = SIM_I2C_now_ns();
+	if (DAC7678_set_value_async(device, DAC7678_CH_F, 600, NULL, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_flush(device) != DAC7678_OK || s_model.dac[5] != 600) return DAC7678_TST_FAIL;
+	if (SIM_I2C_now_ns() - start > 3ULL * DAC7678_STALL_TIMEOUT_US * 1000ULL) return DAC7678_TST_FAIL;
+	if (s_bus.stats.bus_clears != 1 || s_bus.sda_low) return DAC7678_TST_FAIL;
+
+	// the bus is still usable for reads
+	uint16_t value = 0;
+	if (DAC7678_get_value(device, DAC7678_CH_F, &value) != DAC7678_OK || value != 600) return DAC7678_TST_FAIL;
+
+	// a blocking read under a fault is retried like a write, not left to time out
+	SIM_I2C_inject(&s_bus, SIM_I2C_FAULT_NACK, 2);
+	start = SIM_I2C_now_ns();
+	value = 0;
+	if (DAC7678_get_value(device, DAC7678_CH_E, &value) != DAC7678_OK || value != 500) return DAC7678_TST_FAIL;
+	if (SIM_I2C_now_ns() - start > 3ULL * DAC7678_BACKOFF_US * 1000ULL) return DAC7678_TST_FAIL;
+
+	SIM_I2C_inject(&s_bus, SIM_I2C_FAULT_HANG, 1);
+	start = SIM_I2C_now_ns();
+	value = 0;
+	if (DAC7678_get_value(device, DAC7678_CH_F, &value) != DAC7678_OK || value != 600) return DAC7678_TST_FAIL;
+	if (SIM_I2C_now_ns() - start > 3ULL * DAC7678_STALL_TIMEOUT_US * 1000ULL) return DAC7678_TST_FAIL;
+
+	SIM_I2C_inject(&s_bus, SIM_I2C_FAULT_BERR, 1);
+	value = 0;
+	if (DAC7678_get_dac_reg(device, DAC7678_CH_E, &value) != DAC7678_OK || value != 500) return DAC7678_TST_FAIL;
+
+	return DAC7678_TST_PASS;
+}
+
+static DAC7678_Test test_sim_deadlines(DAC7678 *device)
+{
+	SIM_I2C_wait_idle();
+	DAC7678_set_time_source(SIM_I2C_micros);
+	DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_ALL);
+
+	// a deadline taken just before the microsecond counter wraps neither expires early nor hangs
+	SIM_I2C_set_micros_offset(0xFFFFFFFFUL - (uint32_t)(SIM_I2C_now_ns() / 1000ULL) - 50);
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel) device->values[channel] = 100 + channel;
+	if (DAC7678_set_values_async(device, NULL, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_flush(device) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (s_model.dac[7] != 107) return DAC7678_TST_FAIL;
+
+	if (DAC7678_set_timeout(device, 0x80000000UL) != DAC7678_ERROR_INVALID_VALUE) return DAC7678_TST_FAIL;
+
+	// a busy bus fails a bounded call after a few transaction times, not DAC7678_TIMEOUT
+	if (device->m_transport->async)
+	{
+		for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel) device->values[channel] = 200 + channel;
+		if (DAC7678_set_values_async(device, NULL, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+
+		if (DAC7678_set_timeout(device, 300) != DAC7678_OK) return DAC7678_TST_FAIL;
+		uint64_t start = SIM_I2C_now_ns();
+		if (DAC7678_set_value(device, DAC7678_CH_A, 1234) != DAC7678_ERROR_TIMEOUT_TX) return DAC7678_TST_FAIL;
+		if (SIM_I2C_now_ns() - start > 350000ULL) return DAC7678_TST_FAIL;
+
+		start = SIM_I2C_now_ns();
+		if (DAC7678_flush_timeout(device, 100) != DAC7678_ERROR_TIMEOUT_TX) return DAC7678_TST_FAIL;
+		if (SIM_I2C_now_ns() - start > 150000ULL) return DAC7678_TST_FAIL;
+
+		DAC7678_set_timeout(device, DAC7678_TIMEOUT_US);
+		if (DAC7678_flush(device) != DAC7678_OK || s_model.dac[7] != 207) return DAC7678_TST_FAIL;
+	}
+	else
+	{
+		// blocking: the retries and the HAL timeout spend the same bound
+		if (DAC7678_set_timeout(device, 300) != DAC7678_OK) return DAC7678_TST_FAIL;
+		SIM_I2C_inject(&s_bus, SIM_I2C_FAULT_NACK, 3);
+		uint64_t start = SIM_I2C_now_ns();
+		if (DAC7678_set_value(device, DAC7678_CH_A, 1234) != DAC7678_ERROR_NACK) return DAC7678_TST_FAIL;
+		if (SIM_I2C_now_ns() - start > 400000ULL) return DAC7678_TST_FAIL;
+
+		// a hung bus costs the deadline rounded up to the HAL tick, and the next call re-inits first
+		SIM_I2C_inject(&s_bus, SIM_I2C_FAULT_HANG, 1);
+		start = SIM_I2C_now_ns();
+		if (DAC7678_set_value(device, DAC7678_CH_A, 1234) != DAC7678_ERROR_TIMEOUT_TX) return DAC7678_TST_FAIL;
+		if (SIM_I2C_now_ns() - start > 2500000ULL) return DAC7678_TST_FAIL;
+		const uint32_t recoveries = device->m_bus->recoveries;
+		if (DAC7678_set_value(device, DAC7678_CH_A, 1234) != DAC7678_OK || s_model.dac[0] != 1234) return DAC7678_TST_FAIL;
+		if (device->m_bus->recoveries != recoveries + 1) return DAC7678_TST_FAIL;
+
+		DAC7678_set_timeout(device, DAC7678_TIMEOUT_US);
+	}
+
+	SIM_I2C_set_micros_offset(0);
+	DAC7678_set_time_source(NULL);
+
+	return DAC7678_TST_PASS;
+}
+
+#ifdef DAC7678_PERF
+static uint32_t perf_calls(const DAC7678_Perf *perf, const DAC7678_PerfCall call, const uint8_t from_bucket)
+{
+	uint32_t calls = 0;
+	for (uint8_t bucket = from_bucket; bucket < DAC7678_PERF_BUCKETS; ++bucket) calls += perf->latency[call][bucket];
+
+	return calls;
+}
+
+static DAC7678_Test test_sim_perf(DAC7678 *device)
+{
+	SIM_I2C_wait_idle();
+	DAC7678_set_time_source(SIM_I2C_micros);
+	DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_ON);
+	DAC7678_set_cache_policy(device, DAC7678_CACHE_OFF, 0);
+	DAC7678_perf_reset(device);
+
+	// a 3-byte write is 4 bytes on the wire, a 2-byte read 5: address, command, address, MSDB, LSDB
+	DAC7678_Perf perf;
+	uint16_t value = 0;
+	if (DAC7678_set_value(device, DAC7678_CH_A, 1000) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_get_value(device, DAC7678_CH_A, &value) != DAC7678_OK || value != 1000) return DAC7678_TST_FAIL;
+	if (DAC7678_perf_snapshot(device, &perf, 1) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (perf.transactions != 2 || perf.bytes != 9 || perf.retries != 0 || perf.timeouts != 0) return DAC7678_TST_FAIL;
+	if (perf_calls(&perf, DAC7678_PERF_SET_VALUE, 0) != 1 || perf_calls(&perf, DAC7678_PERF_SET_VALUES, 0) != 0) return DAC7678_TST_FAIL;
+	// a read holds the caller for its whole transaction, over 100 us at 400 kHz: bucket 7 and up
+	if (perf_calls(&perf, DAC7678_PERF_GET, 7) != 1) return DAC7678_TST_FAIL;
+
+	// the reset was taken with the snapshot
+	if (DAC7678_perf_snapshot(device, &perf, 0) != DAC7678_OK || perf.transactions != 0) return DAC7678_TST_FAIL;
+	if (perf_calls(&perf, DAC7678_PERF_GET, 0) != 0) return DAC7678_TST_FAIL;
+
+	// eight writes back to back; async callers spin on the handle between them
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel) device->values[channel] = 300 + channel;
+	if (DAC7678_set_values(device) != DAC7678_OK || DAC7678_flush(device) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_set_values_dirty(device, DAC7678_WRT_UPDATE_ON) != DAC7678_OK) return DAC7678_TST_FAIL;
+	DAC7678_perf_snapshot(device, &perf, 1);
+	if (perf.transactions != 8 || perf.bytes != 32 || perf.writes_elided != 8) return DAC7678_TST_FAIL;
+	if (perf_calls(&perf, DAC7678_PERF_SET_VALUES, 0) != 1 || perf_calls(&perf, DAC7678_PERF_SET_VALUE, 0) != 0) return DAC7678_TST_FAIL;
+	if (device->m_transport->async && perf.spin_us < 7 * 80) return DAC7678_TST_FAIL;
+
+	// a glitch costs one repeated transaction
+	SIM_I2C_inject(&s_bus, SIM_I2C_FAULT_NACK, 1);
+	if (DAC7678_set_value(device, DAC7678_CH_B, 2000) != DAC7678_OK || DAC7678_flush(device) != DAC7678_OK) return DAC7678_TST_FAIL;
+	DAC7678_perf_snapshot(device, &perf, 1);
+	if (perf.retries != 1 || perf.transactions != 2) return DAC7678_TST_FAIL;
+
+	// a bounded call on a busy bus counts its timeout
+	if (device->m_transport->async)
+	{
+		if (DAC7678_set_values_async(device, NULL, NULL) != DAC7678_OK) return DAC7678_TST_FAIL;
+		DAC7678_set_timeout(device, 50);
+		if (DAC7678_set_value(device, DAC7678_CH_C, 3000) != DAC7678_ERROR_TIMEOUT_TX) return DAC7678_TST_FAIL;
+		DAC7678_set_timeout(device, DAC7678_TIMEOUT_US);
+		if (DAC7678_flush(device) != DAC7678_OK) return DAC7678_TST_FAIL;
+		DAC7678_perf_snapshot(device, &perf, 1);
+		if (perf.timeouts != 1) return DAC7678_TST_FAIL;
+	}
+
+	DAC7678_set_time_source(NULL);
+
+	return DAC7678_TST_PASS;
+}
+#endif
+
+#ifdef DAC7678_TRACE
+#define TRACE_EVENT(entry) ((entry)->event & 0x0F)
+
+static DAC7678_TraceEntry s_trace[DAC7678_TRACE_SIZE];
+
+static DAC7678_Test test_sim_trace(DAC7678 *device)
+{
+	SIM_I2C_wait_idle();
+	DAC7678_set_time_source(SIM_I2C_micros);
+	DAC7678_set_write_options(device, DAC7678_WRT_UPDATE_ON);
+	DAC7678_set_cache_policy(device, DAC7678_CACHE_OFF, 0);
+
+	// a write and a read, each handed to the transport and then finished
+	uint32_t cursor = DAC7678_trace_head();
+	uint32_t lost = 0;
+	uint16_t value = 0;
+	if (DAC7678_set_value(device, DAC7678_CH_C, 0x3E8) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_get_value(device, DAC7678_CH_C, &value) != DAC7678_OK || value != 0x3E8) return DAC7678_TST_FAIL;
+	if (DAC7678_trace_read(&cursor, s_trace, DAC7678_TRACE_SIZE, &lost) != 4 || lost != 0) return DAC7678_TST_FAIL;
+
+	const DAC7678_TraceEntry *write = &s_trace[0];
+	const DAC7678_TraceEntry *written = &s_trace[1];
+	const DAC7678_TraceEntry *read = &s_trace[2];
+	const DAC7678_TraceEntry *readback = &s_trace[3];
+	if (TRACE_EVENT(write) != DAC7678_TRACE_WRITE || write->address != DAC_ADDRESS || write->state != DAC7678_NONE) return DAC7678_TST_FAIL;
+	if (write->data[0] != (DAC7678_CMD_WRITE_UPDATE | DAC7678_CH_C) || write->size != 2 || write->data[1] != 0x3E || write->data[2] != 0x80) return DAC7678_TST_FAIL;
+	if (TRACE_EVENT(written) != DAC7678_TRACE_DONE || written->state != DAC7678_OK || written->data[0] != write->data[0]) return DAC7678_TST_FAIL;
+	if (written->time_us - write->time_us < 80) return DAC7678_TST_FAIL; // 4 bytes at 400 kHz
+	if (TRACE_EVENT(read) != DAC7678_TRACE_READ || read->data[0] != (DAC7678_CMD_READ_IN_REG | DAC7678_CH_C) || read->size != 2) return DAC7678_TST_FAIL;
+	if (TRACE_EVENT(readback) != DAC7678_TRACE_DONE || readback->size != 2 || readback->data[1] != 0x3E || readback->data[2] != 0x80) return DAC7678_TST_FAIL;
+	if (readback->seq != write->seq + 3) return DAC7678_TST_FAIL;
+
+	// a NACKed frame and its retry
+	SIM_I2C_inject(&s_bus, SIM_I2C_FAULT_NACK, 1);
+	if (DAC7678_set_value(device, DAC7678_CH_D, 5) != DAC7678_OK || DAC7678_flush(device) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_trace_read(&cursor, s_trace, DAC7678_TRACE_SIZE, &lost) != 4) return DAC7678_TST_FAIL;
+	if (s_trace[1].state != DAC7678_ERROR_NACK || TRACE_EVENT(&s_trace[2]) != DAC7678_TRACE_WRITE || s_trace[3].state != DAC7678_OK) return DAC7678_TST_FAIL;
+
+	// a reader a lap behind gets the newest entries and a count of the ones it missed
+	for (uint16_t i = 0; i < DAC7678_TRACE_SIZE; ++i) DAC7678_set_value(device, DAC7678_CH_E, i);
+	if (DAC7678_flush(device) != DAC7678_OK) return DAC7678_TST_FAIL;
+	lost = 0;
+	const uint16_t count = DAC7678_trace_read(&cursor, s_trace, DAC7678_TRACE_SIZE, &lost);
+	if (count != DAC7678_TRACE_SIZE || lost != DAC7678_TRACE_SIZE || cursor != DAC7678_trace_head()) return DAC7678_TST_FAIL;
+	for (uint16_t i = 1; i < count; ++i)
+	{
+		if (s_trace[i].seq != s_trace[i - 1].seq + 1) return DAC7678_TST_FAIL;
+	}
+
+	// some mixed traffic for the dump
+	for (uint8_t channel = 0; channel < DAC7678_MAX_CHANNELS; ++channel) device->values[channel] = 500 * channel;
+	const uint16_t burst[4] = { 100, 200, 300, 400 };
+	DAC7678_ChannelMsk channel_mask;
+	DAC7678_PowerOptions options;
+	if (DAC7678_set_values(device) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_set_power_reg(device, DAC7678_PWR_PLDOWN_100K, DAC7678_CHM_H) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_get_power_reg(device, &options, &channel_mask) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_set_value_burst(device, DAC7678_CH_A, burst, 4) != DAC7678_OK) return DAC7678_TST_FAIL;
+	SIM_I2C_inject(&s_bus, SIM_I2C_FAULT_NACK, 1);
+	if (DAC7678_set_value(device, DAC7678_CH_B, 4095) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_get_dac_reg(device, DAC7678_CH_B, &value) != DAC7678_OK || value != 4095) return DAC7678_TST_FAIL;
+	if (DAC7678_set_power_reg(device, DAC7678_PWR_ON, DAC7678_CHM_H) != DAC7678_OK) return DAC7678_TST_FAIL;
+	if (DAC7678_flush(device) != DAC7678_OK) return DAC7678_TST_FAIL;
+
+	DAC7678_set_time_source(NULL);
+
+	return DAC7678_TST_PASS;
+}
+
+#ifdef SIM_TRACE_DUMP
+// the ring as a firmware would stream it out, for host/trace_decode
+static void trace_dump(const char *path)
+{
+	uint32_t cursor = DAC7678_trace_head() - DAC7678_TRACE_SIZE;
+	const uint16_t count = DAC7678_trace_read(&cursor, s_trace, DAC7678_TRACE_SIZE, NULL);
+
+	FILE *file = fopen(path, "wb");
+	if (file == NULL) return;
+	fwrite(s_trace, sizeof(DAC7678_TraceEntry), count, file);
+	fclose(file);
+}
+#endif
+#endif
+
+int main(void)
+{
+	SIM_I2C_init(&s_bus, &SIM_I2C_FAST);
+	SIM_DAC7678_init(&s_model, DAC_ADDRESS);
+	SIM_I2C_attach(&s_bus, &s_model.device);
+	DAC7678_init(&s_dac, &s_bus.hi2c, DAC_ADDRESS);
+
+	DAC7678_set_write_options(&s_dac, DAC7678_WRT_UPDATE_OFF);
+	check("input register (update off)", test_wr_input_register(&s_dac));
+	DAC7678_set_write_options(&s_dac, DAC7678_WRT_UPDATE_ON);
+	check("input register (update on)", test_wr_input_register(&s_dac));
+	DAC7678_set_write_options(&s_dac, DAC7678_WRT_UPDATE_ALL);
+	check("input register (update all)", test_wr_input_register(&s_dac));
+	check("dac register", test_wr_dac_register(&s_dac));
+	check("reference register static", test_wr_reference_register_static(&s_dac));
+	check("reference register flexi", test_wr_reference_register_flexi(&s_dac));
+	check("power register", test_wr_power_register(&s_dac));
+	check("clear register", test_wr_clear_register(&s_dac));
+	check("ldac register", test_wr_ldac_register(&s_dac));
+	check("values", test_wr_values(&s_dac));
+	check("value burst", test_wr_value_burst(&s_dac));
+	check("values dirty", test_wr_values_dirty(&s_dac));
+	check("cache", test_wr_cache(&s_dac));
+	check("sim registers", test_sim_registers(&s_dac));
+	check("sim pipelined", test_sim_pipelined(&s_dac));
+	check("sim queue", test_sim_queue(&s_dac));
+	check("sim read async", test_sim_read_async(&s_dac));
+	check("sim cache", test_sim_cache(&s_dac));
+	check("sim bus", test_sim_bus(&s_dac));
+	check("sim group", test_sim_group(&s_dac));
+	check("sim wave", test_sim_wave(&s_dac));
+	check("sim dds", test_sim_dds(&s_dac));
+	check("sim slew", test_sim_slew(&s_dac));
+	check("sim stream", test_sim_stream(&s_dac));
+	check("sim calibration", test_sim_calibration(&s_dac));
+	check("sim units", test_sim_units(&s_dac));
+	check("sim transport", test_sim_transport(&s_dac));
+	check("sim hs", test_sim_hs(&s_dac));
+	check("sim recovery", test_sim_recovery(&s_dac));
+	check("sim deadlines", test_sim_deadlines(&s_dac));
+#ifdef DAC7678_PERF
+	check("sim perf", test_sim_perf(&s_dac));
+#endif
+#ifdef DAC7678_TRACE
+	check("sim trace", test_sim_trace(&s_dac));
+#ifdef SIM_TRACE_DUMP
+	trace_dump(SIM_TRACE_DUMP);
+#endif
+#endif
+
+	printf("%d failed\r\n", s_failed);
+
+	return s_failed ? 1 : 0;
+}
@@ -0,0 +1,276 @@
+/*
+ * trace_decode.c
+ *
+ *  Decodes DAC7678_trace dumps into a command log, then prints count,
+ *  failures and start-to-done time per command.
+ *
+ *    trace_decode dump.bin [more.bin ...]
+ *
+ *  Records may come in any order and from overlapping dumps; they are
+ *  sorted by sequence number and duplicates are dropped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "DAC7678_trace.h"
+
+#define RECORD_SIZE		16
+#define MAX_COMMANDS	32
+#define MAX_PENDING		(16 * 128) // bus index, address
+
+typedef struct
+{
+	char		name[24];
+	uint32_t	count;
+	uint32_t	failed;
+	uint32_t	timed;
+	uint64_t	total_us;
+	uint32_t	min_us;
+	uint32_t	max_us;
+} CommandStats;
+
+typedef struct
+{
+	uint32_t	seq; // 0: nothing in flight
+	uint32_t	time_us;
+	uint8_t		event;
+	uint8_t		command;
+} Pending;
+
+static const char *const s_write_names[16] =
+{
+	"WRITE_IN_REG", "UPDATE_DAC_REG", "WRITE_UPDATE_ALL", "WRITE_UPDATE", "WRITE_PWR", "WRITE_CLR_CODE", "WRITE_LDAC", "RESET",
+	"WRITE_REF_STATIC", "WRITE_REF_FLEX",
+};
+
+static const char *const s_read_names[16] =
+{
+	"READ_IN_REG", "READ_DAC_REG", NULL, NULL, "READ_PWR", "READ_CLR_CODE", "READ_LDAC", NULL,
+	"READ_REF_STATIC", "READ_REF_FLEX",
+};
+
+static const char *const s_states[] =
+{
+	"NONE", "OK", "ERROR", "ERROR_TX", "ERROR_RX", "INVALID_VALUE", "INVALID_CHANNEL", "TIMEOUT_TX", "TIMEOUT_RX",
+	"QUEUE_FULL", "NOT_CACHED", "NACK", "ARBITRATION", "BUS",
+};
+
+static CommandStats s_stats[MAX_COMMANDS];
+static uint8_t s_num_stats = 0;
+static Pending s_pending[MAX_PENDING];
+
+static uint32_t read_u32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int compare_seq(const void *a, const void *b)
+{
+	const uint32_t sa = ((const DAC7678_TraceEntry *)a)->seq;
+	const uint32_t sb = ((const DAC7678_TraceEntry *)b)->seq;
+
+	return (sa > sb) - (sa < sb);
+}
+
+static const char *state_name(const int8_t state)
+{
+	const int index = state + 1;
+	if (index < 0 || index >= (int)(sizeof(s_states) / sizeof(s_states[0]))) return "?";
+
+	return s_states[index];
+}
+
+// "WRITE_UPDATE C", "READ_PWR"; channel access commands carry the channel in the low nibble
+static void command_name(char *out, const size_t size, const uint8_t command, const uint8_t read)
+{
+	const char *name = (read ? s_read_names : s_write_names)[command >> 4];
+	if (name == NULL)
+	{
+		snprintf(out, size, "CMD_0x%02X", command);
+		return;
+	}
+
+	const uint8_t channel = command & 0x0F;
+	if ((command >> 4) > 3) snprintf(out, size, "%s", name);
+	else if (channel == 0x0F) snprintf(out, size, "%s ALL", name);
+	else if (channel < 8) snprintf(out, size, "%s %c", name, 'A' + channel);
+	else snprintf(out, size, "%s ?%X", name, channel);
+}
+
+static CommandStats *stats_for(const uint8_t command, const uint8_t read)
+{
+	char name[24];
+	command_name(name, sizeof(name), (uint8_t)(command & 0xF0), read);
+	char *space = strchr(name, ' ');
+	if (space) *space = '\0';
+
+	for (uint8_t i = 0; i < s_num_stats; ++i)
+	{
+		if (strcmp(s_stats[i].name, name) == 0) return &s_stats[i];
+	}
+	if (s_num_stats == MAX_COMMANDS) return NULL;
+
+	CommandStats *stats = &s_stats[s_num_stats++];
+	memset(stats, 0, sizeof(*stats));
+	snprintf(stats->name, sizeof(stats->name), "%s", name);
+	stats->min_us = UINT32_MAX;
+
+	return stats;
+}
+
+// data column: the code of a channel write or readback, the bytes of anything else
+static void payload_text(char *out, const size_t size, const DAC7678_TraceEntry *entry, const uint8_t read)
+{
+	const uint8_t event = entry->event & 0x0F;
+	const uint8_t channel_access = (entry->data[0] >> 4) <= 3;
+	const unsigned code = ((unsigned)entry->data[1] << 4) | (entry->data[2] >> 4);
+
+	out[0] = '\0';
+	if (entry->size == 0) return;
+	if (event == DAC7678_TRACE_READ) snprintf(out, size, "%u bytes", entry->size);
+	else if (channel_access && (entry->size == 2)) snprintf(out, size, "%s%u", read ? "-> " : "= ", code);
+	else if (channel_access && !read) snprintf(out, size, "burst of %u, %u ..", entry->size / 2, code);
+	else
+	{
+		const uint8_t bytes = entry->size < 3 ? entry->size : 3;
+		size_t used = (size_t)snprintf(out, size, "%s", read ? "-> " : "");
+		for (uint8_t i = 0; (i < bytes) && (used < size); ++i) used += (size_t)snprintf(out + used, size - used, "%02X ", entry->data[1 + i]);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s dump.bin [more.bin ...]\n", argv[0]);
+		return 2;
+	}
+
+	size_t count = 0;
+	size_t capacity = 1024;
+	DAC7678_TraceEntry *entries = malloc(capacity * sizeof(*entries));
+	for (int arg = 1; arg < argc; ++arg)
+	{
+		FILE *file = fopen(argv[arg], "rb");
+		if (file == NULL)
+		{
+			perror(argv[arg]);
+			return 1;
+		}
+
+		uint8_t record[RECORD_SIZE];
+		while (fread(record, 1, RECORD_SIZE, file) == RECORD_SIZE)
+		{
+			if (count == capacity)
+			{
+				capacity *= 2;
+				entries = realloc(entries, capacity * sizeof(*entries));
+			}
+
+			DAC7678_TraceEntry *entry = &entries[count];
+			entry->seq = read_u32(&record[0]);
+			entry->time_us = read_u32(&record[4]);
+			entry->event = record[8];
+			entry->address = record[9];
+			entry->state = (int8_t)record[10];
+			entry->size = record[11];
+			memcpy(entry->data, &record[12], 4);
+			if (entry->seq != 0) count++; // caught while being written
+		}
+		fclose(file);
+	}
+
+	qsort(entries, count, sizeof(*entries), compare_seq);
+
+	printf("%8s %10s %3s %4s  %-5s  %-20s %-18s %-12s %s\n", "seq", "us", "bus", "addr", "event", "command", "data", "state", "took");
+
+	uint32_t lost = 0;
+	uint32_t unmatched = 0;
+	size_t shown = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const DAC7678_TraceEntry *entry = &entries[i];
+		if (shown && entry->seq == entries[i - 1].seq) continue;
+		if (shown && entry->seq != entries[i - 1].seq + 1) lost += entry->seq - entries[i - 1].seq - 1;
+		shown++;
+
+		const uint8_t bus = entry->event >> 4;
+		const uint8_t event = entry->event & 0x0F;
+		Pending *pending = &s_pending[(bus & 0x0F) * 128 + (entry->address & 0x7F)];
+		const uint32_t relative = entry->time_us - entries[0].time_us;
+
+		char name[32];
+		char data[32];
+		char took[16] = "";
+		const char *event_name = "?";
+		const char *state = "";
+		uint8_t read = 0;
+
+		if (event == DAC7678_TRACE_WRITE || event == DAC7678_TRACE_READ)
+		{
+			read = event == DAC7678_TRACE_READ;
+			event_name = read ? "read" : "write";
+			if (pending->seq) unmatched++;
+			pending->seq = entry->seq;
+			pending->time_us = entry->time_us;
+			pending->event = event;
+			pending->command = entry->data[0];
+		}
+		else if (event == DAC7678_TRACE_DONE)
+		{
+			event_name = "done";
+			state = state_name(entry->state);
+
+			const uint8_t matched = pending->seq && (pending->command == entry->data[0]);
+			read = matched ? (pending->event == DAC7678_TRACE_READ) : (entry->size != 0);
+
+			CommandStats *stats = stats_for(entry->data[0], read);
+			if (stats)
+			{
+				stats->count++;
+				if (entry->state != DAC7678_OK) stats->failed++;
+			}
+			if (matched)
+			{
+				const uint32_t us = entry->time_us - pending->time_us;
+				snprintf(took, sizeof(took), "%u us", us);
+				if (stats)
+				{
+					stats->timed++;
+					stats->total_us += us;
+					if (us < stats->min_us) stats->min_us = us;
+					if (us > stats->max_us) stats->max_us = us;
+				}
+			}
+			else
+			{
+				unmatched++;
+			}
+			pending->seq = 0;
+		}
+
+		command_name(name, sizeof(name), entry->data[0], read);
+		payload_text(data, sizeof(data), entry, read);
+		printf("%8u %10u %3u 0x%02X  %-5s  %-20s %-18s %-12s %s\n", entry->seq, relative, bus, entry->address, event_name, name, data, state, took);
+	}
+
+	printf("\n%zu entries, %u lost between them, %u without a start or done\n\n", shown, lost, unmatched);
+	printf("%-20s %8s %8s %10s %10s %10s\n", "command", "count", "failed", "min us", "avg us", "max us");
+	for (uint8_t i = 0; i < s_num_stats; ++i)
+	{
+		const CommandStats *stats = &s_stats[i];
+		if (stats->timed == 0)
+		{
+			printf("%-20s %8u %8u %10s %10s %10s\n", stats->name, stats->count, stats->failed, "-", "-", "-");
+			continue;
+		}
+		printf("%-20s %8u %8u %10u %10.1f %10u\n", stats->name, stats->count, stats->failed, stats->min_us,
+				(double)stats->total_us / stats->timed, stats->max_us);
+	}
+
+	free(entries);
+
+	return 0;
+}